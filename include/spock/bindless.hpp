@@ -0,0 +1,44 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+#include <cstdint>
+
+namespace spock {
+    //binding numbers in the bindless set, shaders declare e.g.
+    //  layout(set = 0, binding = 0) uniform texture2D textures[];
+    //  layout(set = 0, binding = 2) uniform sampler samplers[];
+    enum class BindlessType : uint32_t {
+        SampledImage  = 0,
+        StorageImage  = 1,
+        Sampler       = 2,
+        StorageBuffer = 3,
+        Count,
+    };
+
+    struct BindlessCounts {
+        uint32_t sampledImages  = 16384;
+        uint32_t storageImages  = 4096;
+        uint32_t samplers       = 256;
+        uint32_t storageBuffers = 16384;
+    };
+
+    //one update-after-bind, partially bound descriptor set holding every registered resource.
+    //counts are clamped to the device's update-after-bind limits. called by init()
+    void                  init_bindless(const BindlessCounts& counts);
+    void                  destroy_bindless();
+    //returns indices released by unregister_bindless whose frames have finished on the gpu, called by begin_frame.
+    //an index unregistered in frame N is reused at the earliest once frame N has completed
+    void                  collect_bindless();
+
+    VkDescriptorSetLayout bindless_layout();
+    VkDescriptorSet       bindless_set();
+    void                  bind_bindless(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t setIndex = 0);
+
+    //register a resource and get its stable index into the matching array. thread safe.
+    //the index stays valid until unregistered and is only reused once the gpu is done with it.
+    //running out of slots logs and aborts
+    uint32_t              register_sampled_image(VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    uint32_t              register_storage_image(VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_GENERAL);
+    uint32_t              register_sampler(VkSampler sampler);
+    uint32_t              register_storage_buffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+    void                  unregister_bindless(BindlessType type, uint32_t index);
+}
@@ -4,6 +4,9 @@
 #include "vk_mem_alloc.h"
 #include "types.hpp"
 #include "shader.hpp"
+#include "sync.hpp"
+#include "bindless.hpp"
+#include "descriptor.hpp"
 
 namespace spock {
     void  clean_init();
@@ -29,9 +32,61 @@ namespace spock {
         uint32_t         count = 1;
     };
 
-    void                  update_descriptor_sets(std::initializer_list<ImageWrite> imageWrites, std::initializer_list<BufferWrite> bufferWrites);
+    struct TexelBufferWrite {
+        VkDescriptorSet  descriptorSet;
+        uint32_t         binding;
+        VkDescriptorType descriptorType;
+        VkBufferView     view;
+        uint32_t         index = 0;
+        uint32_t         count = 1;
+    };
+
+    //all writes go out in one call, with no limit on their number (see DescriptorWriter for building batches incrementally)
+    void                  update_descriptor_sets(std::initializer_list<ImageWrite> imageWrites, std::initializer_list<BufferWrite> bufferWrites,
+                                                 std::initializer_list<TexelBufferWrite> texelBufferWrites = {});
+
+    //for sets that are rewritten often: the template records the layout of the writes once and
+    //update_descriptor_set then takes a DescriptorData array, count entries per binding in the order given
+    VkDescriptorUpdateTemplate create_descriptor_update_template(VkDescriptorSetLayout layout, std::initializer_list<Binding> bindings);
+    void                  update_descriptor_set(VkDescriptorSet set, VkDescriptorUpdateTemplate updateTemplate, const DescriptorData* data);
+
+    //push descriptors (ctx.pushDescriptors): small per-draw sets written straight into the command buffer,
+    //no pool allocation or set update. the set layout is created with VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR
+    //and a pipeline layout may contain at most one such set. descriptorSet in the writes is ignored.
+    void                  push_descriptor_set(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t set,
+                                              std::initializer_list<ImageWrite> imageWrites, std::initializer_list<BufferWrite> bufferWrites);
+    //template variant, data is laid out as for update_descriptor_set
+    VkDescriptorUpdateTemplate create_push_descriptor_template(VkDescriptorSetLayout setLayout, std::initializer_list<Binding> bindings,
+                                                               VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t set);
+    void                  push_descriptor_set(VkCommandBuffer cmd, VkDescriptorUpdateTemplate updateTemplate, VkPipelineLayout layout, uint32_t set,
+                                              const DescriptorData* data);
+
+    struct InitInfo {
+        uint32_t     frameOverlap = 2; //frames in flight, each with its own command pool, sync objects and descriptor allocator
+        uint32_t     recordingThreads = 0; //per-frame command pools for secondary recording, 0 = one per hardware thread
+
+        //headless: no glfw window, surface or swapchain. ctx.offscreenImages (one per frame in flight)
+        //are created instead, for batch rendering, compute and perf runs on machines without a display.
+        bool         headless        = false;
+        VkExtent2D   offscreenExtent = {1920, 1080};
+        VkFormat     offscreenFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+        double           resizeDebounce      = 0.1; //seconds a resize has to settle before the swapchain is rebuilt
+        VkPresentModeKHR presentMode         = VK_PRESENT_MODE_FIFO_KHR;
+        uint32_t         swapchainImageCount = 0; //minimum swapchain images, 0 = driver default
+        //max presents the cpu may run ahead of the screen, needs VK_KHR_present_wait. 0 = no pacing
+        uint32_t         presentLatency      = 0;
+
+        VkDeviceSize stagingRingSize    = 64 * 1024 * 1024; //persistently mapped staging memory shared by all uploads
+        uint32_t     gpuProfilerScopes  = 256; //GpuScopes per frame, 0 disables the gpu profiler
+        VkDeviceSize frameAllocatorSize = 8 * 1024 * 1024; //per-frame linear allocator block size (linear_allocator.hpp)
+        BindlessCounts bindless; //array sizes of the bindless set (bindless.hpp)
+        bool         descriptorBuffer   = false; //enable VK_EXT_descriptor_buffer if supported (descriptor_buffer.hpp)
+        //pipeline cache file, loaded by init and written by cleanup. nullptr keeps the cache in memory only
+        const char*  pipelineCachePath  = "pipeline_cache.bin";
+    };
 
-    void                  init();
+    void                  init(const InitInfo& info = {});
     
     void                  cleanup();
     VkDescriptorSetLayout create_descriptor_set_layout(std::initializer_list<Binding> _bindings, VkShaderStageFlags shaderStages, VkDescriptorSetLayoutCreateFlags flags = 0);
@@ -39,28 +94,43 @@ namespace spock {
 
     Image                 create_image_from_pixels(void* data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped = false);
 
-    Image                 create_image(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped = false);
-    inline Image          create_image(VkExtent2D size, VkFormat format, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped = false)
-        { return create_image(VkExtent3D{.width = size.width, .height = size.height, .depth = 1}, format, usage, viewType, mipmapped); }
+    //tag is the category the allocation is counted under in get_memory_stats (memory.hpp)
+    Image                 create_image(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped = false, MemoryTag tag = MemoryTag::General);
+    inline Image          create_image(VkExtent2D size, VkFormat format, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped = false, MemoryTag tag = MemoryTag::General)
+        { return create_image(VkExtent3D{.width = size.width, .height = size.height, .depth = 1}, format, usage, viewType, mipmapped, tag); }
 
-    Image                 create_image(void* data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped = false);
-    Image                 create_image(const char* fileName, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped = false);
+    Image                 create_image(void* data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped = false, MemoryTag tag = MemoryTag::Textures);
+    Image                 create_image(const char* fileName, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped = false, MemoryTag tag = MemoryTag::Textures);
 
     Image                 create_texture(const char* fileName, uint32_t index, VkDescriptorSet descriptorSet, uint32_t binding, VkSampler sampler, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped = false);
     void                  create_texture(Image& image, uint32_t index, VkDescriptorSet descriptorSet, uint32_t binding, VkSampler sampler);
+    //loads the image and registers it in the bindless set, image.index is its sampled image index
+    Image                 create_bindless_texture(const char* fileName, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped = false);
 
     void                  destroy_image(Image image);
 
-    Buffer                create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
+    //only GPU_ONLY buffers are left unmapped, prefer the MemoryIntent overload
+    Buffer                create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, MemoryTag tag = MemoryTag::General);
+    //buffer.info.pMappedData is set whenever the chosen memory is host visible
+    Buffer                create_buffer(size_t allocSize, VkBufferUsageFlags usage, MemoryIntent intent, MemoryTag tag = MemoryTag::General);
 
-    // ONLY use for gpu-only buffers at initialisation
-    void copy_to_buffer(VkBuffer buffer, void* src, VkDeviceSize srcOffset, VkDeviceSize dstOffset, VkDeviceSize size);
+    // ONLY use for gpu-only buffers. doesn't block, the returned ticket completes when the copy has executed.
+    // inside an upload batch (upload.hpp) the copy joins the batch and the ticket is empty (!valid()), use end_upload_batch's.
+    // the copy is ordered after all graphics work submitted before it, so it never overwrites data in-flight frames read.
+    Ticket                copy_to_buffer(VkBuffer buffer, void* src, VkDeviceSize srcOffset, VkDeviceSize dstOffset, VkDeviceSize size);
+    // writes straight into mapped memory when the buffer has it (e.g. DeviceHostVisible on ReBAR) and returns
+    // a completed ticket, otherwise goes through staging like the VkBuffer overload.
+    // direct writes aren't ordered against gpu work, the range must not be in use
+    Ticket                copy_to_buffer(const Buffer& buffer, void* src, VkDeviceSize srcOffset, VkDeviceSize dstOffset, VkDeviceSize size);
     void                  destroy_buffer(Buffer buffer);
 
     void                  create_swapchain(uint32_t width, uint32_t height);
 
+    //one-off commands recorded into ctx.immCommandBuffer, from a single thread.
+    //end_immediate_command blocks until the gpu is done, the async variant returns a ticket instead.
     VkCommandBuffer       get_immediate_command_buffer();
     void                  begin_immediate_command();
     void                  end_immediate_command();
+    Ticket                end_immediate_command_async();
 
 }
@@ -1,23 +1,76 @@
 #pragma once
 #include <vulkan/vulkan_core.h>
+#include <initializer_list>
 #include <vector>
 
 namespace spock {
+    //growable descriptor pools. pools are sized from per-type ratios (descriptors of that type per set),
+    //a pool that runs out goes to the full list and the next one is created with more sets,
+    //up to maxSetsPerPool. clear_pools resets the pools allocated from since the last clear and keeps all of them for reuse.
+    //allocating a layout that doesn't fit an empty pool (types missing from the ratios, or more per set than
+    //ratio * sets) aborts.
     struct DescriptorAllocator {
-        VkDescriptorType type;
-        uint32_t         startSize;
+        struct PoolRatio {
+            VkDescriptorType type;
+            float            ratio;
+        };
+
+        std::vector<PoolRatio>        ratios;
+        uint32_t                      setsPerPool    = 0; //sets in the next pool created
+        uint32_t                      maxSetsPerPool = 4096;
 
         bool                          initialised = false;
-        std::vector<VkDescriptorPool> pools;
-        uint32_t                      currentPool = 0;
-        uint32_t                      setsPerPool = 0;
+        std::vector<VkDescriptorPool> readyPools; //may still have room
+        std::vector<VkDescriptorPool> fullPools;
+        std::vector<VkDescriptorPool> usedPools; //ready pools with sets in them, untouched ones skip the reset
         VkDescriptorPoolCreateFlags   flags       = 0;
 
+        void                          init(uint32_t initialSets, std::initializer_list<PoolRatio> poolRatios, uint32_t maxSets = 4096);
+        //single type, startSize descriptors per set
         void                          init(VkDescriptorType type, uint32_t startSize);
-        VkDescriptorPool              create_pool();
+        VkDescriptorPool              create_pool(uint32_t setCount);
         void                          set_flags(VkDescriptorPoolCreateFlags flags);
         void                          clear_pools();
         void                          destroy_pools();
         VkDescriptorSet               allocate(VkDescriptorSetLayout layout);
+
+      private:
+        //created: the pool is new, not one from readyPools
+        VkDescriptorPool              get_pool(bool& created);
+    };
+
+    //batches descriptor writes into one vkUpdateDescriptorSets call. consecutive array elements of the
+    //same binding are merged into a single write. the storage is reused, so a writer kept around
+    //(or thread_local) stops allocating once it has seen its largest batch.
+    struct DescriptorWriter {
+        std::vector<VkWriteDescriptorSet>   writes;
+        std::vector<uint32_t>               infoOffsets; //per write, into the info array matching its type
+        std::vector<VkDescriptorImageInfo>  imageInfos;
+        std::vector<VkDescriptorBufferInfo> bufferInfos;
+        std::vector<VkBufferView>           texelBufferViews;
+
+        DescriptorWriter&                   write_image(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkSampler sampler, VkImageView view,
+                                                        VkImageLayout layout, uint32_t arrayElement = 0);
+        DescriptorWriter&                   write_buffer(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset,
+                                                         VkDeviceSize range, uint32_t arrayElement = 0);
+        DescriptorWriter&                   write_texel_buffer(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkBufferView view,
+                                                               uint32_t arrayElement = 0);
+        //applies and clears all pending writes
+        void                                update();
+        //records the pending writes as push descriptors for set of layout instead (dstSet is ignored), then clears them
+        void                                push(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t set);
+        void                                clear();
+
+      private:
+        //returns true if the write extended the previous one
+        bool                                append(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, uint32_t arrayElement, uint32_t infoOffset);
+    };
+
+    //one descriptor in the data passed to update_descriptor_set, which is a tightly packed
+    //DescriptorData array in template binding order, count entries per binding
+    union DescriptorData {
+        VkDescriptorImageInfo  image;
+        VkDescriptorBufferInfo buffer;
+        VkBufferView           texelBuffer;
     };
 }
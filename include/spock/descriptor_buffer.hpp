@@ -0,0 +1,49 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+#include <atomic>
+#include <initializer_list>
+#include "types.hpp"
+
+namespace spock {
+    //VK_EXT_descriptor_buffer backend, opt-in with InitInfo::descriptorBuffer and available when ctx.descriptorBuffer is set.
+    //set layouts are created with VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT, the pipeline builders
+    //then add VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT by themselves. a pipeline layout can't mix both kinds.
+    //
+    //descriptors are plain memory in a host visible buffer: a set is an offset, writing a descriptor is a
+    //memcpy (flushed if the memory isn't coherent), binding is a buffer offset instead of vkCmdBindDescriptorSets.
+    //writes from several threads need no locking as long as they go to different descriptors.
+    //the gpu reads the memory at execution time, don't overwrite sets that frames in flight still use
+    //(e.g. keep one DescriptorBuffer per frame and reset() it in begin_frame).
+
+    //queries descriptor sizes and loads the extension's functions, called by init()
+    void init_descriptor_buffers();
+
+    struct DescriptorBuffer {
+        Buffer                    buffer  = {};
+        VkDeviceAddress           address = 0;
+        VkBufferUsageFlags        usage   = 0;
+        std::atomic<VkDeviceSize> head    = 0;
+
+        //samplers: also holds sampler and combined image sampler descriptors
+        void                      init(VkDeviceSize size, bool samplers = true);
+        void                      destroy();
+        //space for one set of layout, returns its offset. thread safe
+        VkDeviceSize              allocate(VkDescriptorSetLayout layout);
+        void                      reset();
+
+        //write one descriptor of the set at setOffset. layout must come from create_descriptor_set_layout
+        //(the layout cache), devices without combinedImageSamplerDescriptorSingleArray need the binding's descriptorCount
+        void                      write_image(VkDeviceSize setOffset, VkDescriptorSetLayout layout, uint32_t binding, VkDescriptorType type, VkSampler sampler,
+                                              VkImageView view, VkImageLayout imageLayout, uint32_t arrayElement = 0);
+        //address/range of the buffer region. texel buffers also need format
+        void                      write_buffer(VkDeviceSize setOffset, VkDescriptorSetLayout layout, uint32_t binding, VkDescriptorType type,
+                                               VkDeviceAddress bufferAddress, VkDeviceSize range, uint32_t arrayElement = 0,
+                                               VkFormat format = VK_FORMAT_UNDEFINED);
+    };
+
+    //binds the buffers to the command buffer, their position in the list is the bufferIndex below
+    void bind_descriptor_buffers(VkCommandBuffer cmd, std::initializer_list<const DescriptorBuffer*> buffers);
+    //points set firstSet + i of layout at offsets[i] in bound buffer bufferIndices[i]
+    void set_descriptor_buffer_offsets(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet,
+                                       std::initializer_list<uint32_t> bufferIndices, std::initializer_list<VkDeviceSize> offsets);
+}
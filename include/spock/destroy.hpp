@@ -1,5 +1,8 @@
 #pragma once
 #include <vulkan/vulkan_core.h>
+#include <cstdint>
+#include <mutex>
+#include <utility>
 #include "types.hpp"
 #include "vk_mem_alloc.h"
 namespace spock {
@@ -18,19 +21,23 @@ namespace spock {
             CommandPool,
             Buffer,
             Sampler,
+            Swapchain,
+            DescriptorUpdateTemplate,
         };
 
         union {
-            VkImage               image;
-            VkImageView           imageView;
-            VkDescriptorSetLayout dsl;
-            VkDescriptorPool      dp;
-            VkPipelineLayout      pll;
-            VkPipeline            pl;
-            VkFence               fence;
-            VkCommandPool         commandPool;
-            VkBuffer              buffer;
-            VkSampler             sampler;
+            VkImage                    image;
+            VkImageView                imageView;
+            VkDescriptorSetLayout      dsl;
+            VkDescriptorPool           dp;
+            VkPipelineLayout           pll;
+            VkPipeline                 pl;
+            VkFence                    fence;
+            VkCommandPool              commandPool;
+            VkBuffer                   buffer;
+            VkSampler                  sampler;
+            VkSwapchainKHR             swapchain;
+            VkDescriptorUpdateTemplate dut;
         };
         VmaAllocation allocation;
         OBJ           type;
@@ -50,17 +57,25 @@ namespace spock {
         Object(VkCommandPool _commandPool) : commandPool(_commandPool), type(OBJ::CommandPool) {}
         Object(spock::Buffer _buffer) : buffer(_buffer.buffer), allocation(_buffer.allocation), type(OBJ::Buffer) {}
         Object(VkSampler _sampler) : sampler(_sampler), type(OBJ::Sampler) {}
+        Object(VkSwapchainKHR _swapchain) : swapchain(_swapchain), type(OBJ::Swapchain) {}
+        Object(VkDescriptorUpdateTemplate _dut) : dut(_dut), type(OBJ::DescriptorUpdateTemplate) {}
 
         void destroy();
     };
 
+    //push and collect are thread safe, pipelines are built from worker threads (build_pipelines)
     class DestroyQueue {
       public:
         void flush();
         void push(Object _o);
+        //destroyed by collect() once the graphics timeline reaches timelineValue
+        void push(Object _o, uint64_t timelineValue);
+        void collect(uint64_t completedValue);
 
       private:
-        std::vector<Object> queue;
+        std::mutex                                mutex;
+        std::vector<Object>                       queue;
+        std::vector<std::pair<uint64_t, Object>> deferred;
     };
 
 }
@@ -5,24 +5,45 @@
 #include "types.hpp"
 #include "destroy.hpp"
 #include "descriptor.hpp"
+#include "sync.hpp"
+#include "query.hpp"
+#include "linear_allocator.hpp"
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
 namespace spock {
-    constexpr uint32_t FRAME_OVERLAP = 1;
+    //per recording thread, so workers never share a command pool
+    struct ThreadCommands {
+        VkCommandPool                pool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> secondaries;
+        uint32_t                     used = 0; //secondaries handed out this frame
+    };
+
     struct FrameContext {
         VkCommandPool               commandPool;
         VkCommandBuffer             commandBuffer;
         VkSemaphore                 swapchainSemaphore, renderSemaphore;
-        VkFence                     renderFence;
+        uint64_t                    timelineValue = 0; //ctx.timeline value signalled by this frame's last submit
+        //recorded and submitted separately so compute passes can overlap the frame's graphics work
+        VkCommandPool               computeCommandPool;
+        VkCommandBuffer             computeCommandBuffer;
+        uint64_t                    computeTimelineValue = 0;
+        //indexed by worker thread, reset as a whole in begin_frame
+        std::vector<ThreadCommands> threadCommands;
+        //pipeline statistics and occlusion queries recorded this frame, read back in begin_frame
+        QueryAllocator              statisticsQueries;
+        QueryAllocator              occlusionQueries;
+        //transient uniform/vertex data, reset in begin_frame
+        LinearAllocator             linearAllocator;
         spock::DestroyQueue        destroyQueue;
         spock::DescriptorAllocator descriptorAllocator;
     };
 
     inline struct RenderContext {
         bool                        initialised = false;
+        bool                        headless    = false;
         VkDevice                    device;
         VkInstance                  instance;
         VkDebugUtilsMessengerEXT    debugMessenger;
@@ -31,30 +52,78 @@ namespace spock {
         VkQueue                     graphicsQueue;
         uint32_t                    graphicsQueueFamily;
         VmaAllocator                allocator;
+        //optional device features
+        bool                        pipelineStatisticsQuery = false;
+        bool                        occlusionQueryPrecise   = false;
+        //a large device local + host visible heap (resizable BAR or unified memory)
+        bool                        deviceLocalHostVisible  = false;
+        //VK_KHR_push_descriptor
+        bool                                      pushDescriptors                    = false;
+        PFN_vkCmdPushDescriptorSetKHR             pfnCmdPushDescriptorSet             = nullptr;
+        PFN_vkCmdPushDescriptorSetWithTemplateKHR pfnCmdPushDescriptorSetWithTemplate = nullptr;
+        //VK_EXT_descriptor_buffer, only enabled on request (descriptor_buffer.hpp)
+        bool                                      descriptorBuffer                   = false;
+        //shared by all pipeline builders, persisted across runs (pipeline_cache.hpp)
+        VkPipelineCache             pipelineCache = VK_NULL_HANDLE;
+
+        //device-wide gpu progress, signalled by every spock submission on the graphics queue
+        Timeline                    timeline;
+
+        //streaming uploads. without a dedicated transfer family these alias the graphics queue
+        //and the transfer timeline/command pool are unused
+        VkQueue                     transferQueue;
+        uint32_t                    transferQueueFamily;
+        bool                        dedicatedTransfer = false;
+        //separate timeline, signal order across queues isn't monotonic
+        Timeline                    transferTimeline;
+        CommandBufferPool           transferCommands;
 
-        FrameContext                frames[FRAME_OVERLAP];
+        //async compute, aliases the graphics queue and timeline when there is no separate compute family.
+        //resources used on both queues need VK_SHARING_MODE_CONCURRENT or ownership transfer barriers
+        VkQueue                     computeQueue;
+        uint32_t                    computeQueueFamily;
+        bool                        asyncCompute = false;
+        Timeline                    computeTimeline;
+
+        //one per frame in flight, sized at init()
+        std::vector<FrameContext>   frames;
+        uint32_t                    frameOverlap = 2;
 
         uint32_t                    frameIdx = 0;
 
-        //command buffer for immediate commands
-        VkCommandPool   immCommandPool;
-        VkCommandBuffer immCommandBuffer;
-        VkFence         immCommandFence;
+        //command buffers for immediate commands, immCommandBuffer is the one currently recording
+        CommandBufferPool immCommands;
+        VkCommandBuffer   immCommandBuffer = VK_NULL_HANDLE;
 
         GLFWwindow*     window;
         GLFWmonitor*    monitor;
         VkExtent2D      windowExtent;
+        //set by resizes and suboptimal/out of date results, handled in acquire_swapchain_image
+        bool            swapchainDirty = false;
+        double          lastResizeTime = 0.0;
+        double          resizeDebounce = 0.1;
+
+        VkPresentModeKHR presentMode    = VK_PRESENT_MODE_FIFO_KHR; //requested, swapchain.presentMode is the one in use
+        uint32_t         minImageCount  = 0;
+        uint32_t         presentLatency = 0;
+        //VK_KHR_present_id + VK_KHR_present_wait
+        bool                    presentWaitSupported    = false;
+        PFN_vkWaitForPresentKHR pfnWaitForPresent       = nullptr;
+        uint64_t                presentId               = 0; //id of the last present
+        uint64_t                swapchainFirstPresentId = 1;
+
         VkExtent3D      screenExtent; //desktop resolution
         float           renderScale = 1.f;
 
         VkExtent2D      extent; //swapchain image size
 
         struct Swapchain {
-            VkSwapchainKHR           swapchain;
+            VkSwapchainKHR           swapchain = VK_NULL_HANDLE;
             std::vector<VkImage>     images;
             std::vector<VkImageView> imageViews;
             VkFormat                 imageFormat;
             VkExtent2D               extent;
+            VkPresentModeKHR         presentMode;
         };
 
         //settable by the "user"
@@ -66,20 +135,68 @@ namespace spock {
         */
 
         Swapchain            swapchain;
+        //render targets used instead of the swapchain in headless mode
+        std::vector<Image>   offscreenImages;
         spock::DestroyQueue destroyQueue;
     } ctx;
 
     inline uint32_t         get_frame_number() {
-        return ctx.frameIdx % FRAME_OVERLAP;
+        return ctx.frameIdx % ctx.frameOverlap;
     }
     inline FrameContext&         get_frame() {
-        return ctx.frames[ctx.frameIdx % FRAME_OVERLAP];
+        return ctx.frames[ctx.frameIdx % ctx.frameOverlap];
+    }
+    //headless only: the current frame's offscreen render target
+    inline Image&       get_offscreen_image() {
+        return ctx.offscreenImages[get_frame_number()];
     }
     inline void         finish_frame() {
         ctx.frameIdx++;
     }
+    //waits until the current frame's previous submission has finished on the gpu,
+    //then recycles its command buffer, descriptor pools and destroy queue.
+    FrameContext&       begin_frame();
+    //submits the frame's command buffer, waiting on swapchainSemaphore and signalling
+    //renderSemaphore for present plus the next timeline value.
+    //waits are extra gpu-side waits, e.g. submit_frame_compute(frame).wait_info(stage)
+    uint64_t            submit_frame(FrameContext& frame, std::initializer_list<VkSemaphoreSubmitInfo> waits = {});
+    //acquires the next swapchain image, signalling frame.swapchainSemaphore. recreates the swapchain
+    //first if a resize settled for resizeDebounce seconds. returns false if there is nothing to render to
+    //this frame (minimised or out of date), in which case the frame must not be submitted.
+    bool                acquire_swapchain_image(FrameContext& frame, uint32_t& imageIndex);
+    //presents after the frame's submit, out of date/suboptimal results schedule a recreation
+    void                present_frame(FrameContext& frame, uint32_t imageIndex);
+    //switches present mode at the next frame boundary. modes the surface doesn't support fall back
+    //to FIFO (MAILBOX -> FIFO, IMMEDIATE -> FIFO, FIFO_RELAXED -> FIFO)
+    void                set_present_mode(VkPresentModeKHR mode);
+    //blocks until the present framesBehind presents ago is on screen. no-op without present wait support.
+    //begin_frame calls this with InitInfo::presentLatency when it is set
+    void                wait_for_present(uint32_t framesBehind);
+    //submits the frame's computeCommandBuffer on ctx.computeQueue
+    Ticket              submit_frame_compute(FrameContext& frame, std::initializer_list<VkSemaphoreSubmitInfo> waits = {});
+
+    //multithreaded recording: each worker passes its own threadIdx (< InitInfo::recordingThreads) and records
+    //a secondary command buffer from the current frame's pool for that thread. this overload inherits dynamic
+    //rendering state, the primary must use begin_dynamic_rendering(..., VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT).
+    //dynamic state (viewport, scissor) is not inherited and has to be set in every secondary.
+    VkCommandBuffer     begin_secondary_command(uint32_t threadIdx, std::initializer_list<VkFormat> colorFormats, VkFormat depthFormat = VK_FORMAT_UNDEFINED,
+                                                VkFormat stencilFormat = VK_FORMAT_UNDEFINED, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT,
+                                                uint32_t viewMask = 0);
+    //secondary recorded outside of rendering, e.g. copies or dispatches
+    VkCommandBuffer     begin_secondary_command(uint32_t threadIdx);
+    void                end_secondary_command(VkCommandBuffer cmd);
+    void                execute_secondary_commands(VkCommandBuffer primary, const VkCommandBuffer* cmds, uint32_t count);
+
+    inline Timeline&    compute_timeline() {
+        return ctx.asyncCompute ? ctx.computeTimeline : ctx.timeline;
+    }
     inline DestroyQueue destroyQueue;
 
+    //destroys o once everything submitted so far has finished on the gpu
+    inline void         destroy_deferred(Object o) {
+        destroyQueue.push(o, ctx.timeline.value);
+    }
+
 #ifdef DBG
 #define QUEUE_DESTROY_OBJ(x)                                                                                                                                                       \
     do {                                                                                                                                                                           \
@@ -0,0 +1,19 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+#include <cstdint>
+
+namespace spock {
+    //descriptor set and pipeline layouts keyed by their structure, identical requests return the same handle.
+    //the caches own the layouts, they are destroyed by cleanup(). thread safe.
+    //create_descriptor_set_layout, create_pipeline_layout and the pipeline builders go through these.
+    VkDescriptorSetLayout cached_descriptor_set_layout(const VkDescriptorSetLayoutBinding* bindings, const VkDescriptorBindingFlags* bindingFlags,
+                                                       uint32_t bindingCount, VkDescriptorSetLayoutCreateFlags flags);
+    VkPipelineLayout      cached_pipeline_layout(const VkDescriptorSetLayout* setLayouts, uint32_t setLayoutCount, const VkPushConstantRange* ranges,
+                                                 uint32_t rangeCount);
+    //true if the pipeline layout's set layouts use VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT,
+    //pipelines built with it then need VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT
+    bool                  uses_descriptor_buffer(VkPipelineLayout layout);
+    //descriptorCount of a binding in a cached descriptor buffer set layout
+    uint32_t              cached_binding_count(VkDescriptorSetLayout layout, uint32_t binding);
+    void                  destroy_layout_caches();
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include "types.hpp"
+
+namespace spock {
+    //a sub-range of a linear allocator's buffer, valid until its frame slot comes around again
+    struct TransientAllocation {
+        VkBuffer        buffer  = VK_NULL_HANDLE;
+        VkDeviceSize    offset  = 0;
+        VkDeviceSize    size    = 0;
+        void*           data    = nullptr; //persistently mapped
+        VkDeviceAddress address = 0;       //of data, for buffer device address access
+    };
+
+    //bump allocator over persistently mapped, host visible buffers. allocations are a pointer bump,
+    //reset() makes the whole range reusable. if a block runs out another one is created and kept,
+    //so the allocator settles at the peak per-frame usage.
+    struct LinearAllocator {
+        struct Block {
+            Buffer          buffer;
+            VkDeviceAddress address;
+        };
+
+        VkDeviceSize       blockSize    = 0;
+        VkDeviceSize       minAlignment = 1;
+        std::vector<Block> blocks;
+        uint32_t           current      = 0; //block being allocated from
+        VkDeviceSize       head         = 0; //next free byte in blocks[current]
+        std::mutex         mutex;
+
+        void                init(VkDeviceSize blockSize);
+        void                destroy();
+        //alignment 0 uses the uniform/storage buffer offset alignment of the device
+        TransientAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+        //flushes written ranges for non-coherent memory, before the submit that reads them
+        void                flush();
+        void                reset();
+    };
+
+    //allocates from the current frame's allocator, recycled once that frame's submission has finished
+    TransientAllocation frame_allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+    template <typename T>
+    TransientAllocation frame_upload(const T& value, VkDeviceSize alignment = 0) {
+        TransientAllocation a = frame_allocate(sizeof(T), alignment);
+        memcpy(a.data, &value, sizeof(T));
+        return a;
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+#include <vector>
+#include "types.hpp"
+#include "vk_mem_alloc.h"
+
+namespace spock {
+    struct HeapStats {
+        VkDeviceSize budget;  //what the process can use before the os/driver starts evicting or failing
+        VkDeviceSize usage;   //current process usage as reported by the driver, includes non-spock allocations
+        VkDeviceSize tracked; //live bytes of spock allocations in this heap
+        bool         deviceLocal;
+    };
+
+    struct MemoryStats {
+        VkDeviceSize           tagBytes[(size_t)MemoryTag::Count];
+        uint32_t               tagAllocations[(size_t)MemoryTag::Count];
+        std::vector<HeapStats> heaps;
+    };
+
+    //create_buffer/create_image record every allocation under its tag, the destroy paths remove it again
+    void        track_allocation(VmaAllocation allocation, MemoryTag tag);
+    void        untrack_allocation(VmaAllocation allocation);
+    //refreshes the cached heap budgets, called by begin_frame. budgets are exact with VK_EXT_memory_budget,
+    //estimated by vma otherwise
+    void        update_memory_budget();
+    MemoryStats get_memory_stats();
+    //true if any heap's usage is above its budget as of the last update
+    bool        over_memory_budget();
+    const char* memory_tag_name(MemoryTag tag);
+}
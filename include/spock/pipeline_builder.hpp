@@ -1,5 +1,7 @@
 #pragma once
 #include <initializer_list>
+#include <span>
+#include <vector>
 #include <vulkan/vulkan_core.h>
 #include "types.hpp"
 
@@ -96,3 +98,16 @@ struct GraphicsPipelineBuilder {
 
     VkPipeline build();
 };
+
+struct PipelineBuildResult {
+    VkPipeline pipeline;
+    double     ms; //time spent in build() on its worker, including pipeline cache hits
+};
+
+//builds every builder on a persistent pool of worker threads, one pipeline per job, and returns once all are done.
+//results are in the order of builders, which also get their pipeline and layout set like with build().
+//threadCount 0 = one per hardware thread. compiles share ctx.pipelineCache, so a warm cache makes this cheap
+std::vector<PipelineBuildResult> build_pipelines(std::span<GraphicsPipelineBuilder> builders, uint32_t threadCount = 0);
+std::vector<PipelineBuildResult> build_pipelines(std::span<ComputePipelineBuilder> builders, uint32_t threadCount = 0);
+//build_pipelines keeps its worker threads alive between calls, joins them. called by cleanup()
+void                             destroy_pipeline_workers();
@@ -0,0 +1,13 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+namespace spock {
+    //the VkPipelineCache in ctx.pipelineCache is used by every pipeline builder. init() loads it from
+    //InitInfo::pipelineCachePath, cleanup() writes it back. a file written by another driver or gpu
+    //is detected from its header and ignored, the cache then starts empty.
+    void init_pipeline_cache(const char* path);
+    void destroy_pipeline_cache();
+    //writes the cache to path (the init path if null), through a temporary file that is renamed over
+    //the old one, so a crash mid-write never leaves a truncated cache behind
+    bool save_pipeline_cache(const char* path = nullptr);
+}
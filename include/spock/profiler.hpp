@@ -0,0 +1,49 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace spock {
+    //one resolved gpu scope. timings are stored in scope begin order, so a node's
+    //children follow it and parent is always a lower index (UINT32_MAX for roots)
+    struct GpuTiming {
+        std::string name;
+        uint32_t    parent;
+        uint32_t    depth;
+        double      ms;
+    };
+
+    //timestamp query pools, one per frame in flight, with room for maxScopes scopes each.
+    //called by init() with InitInfo::gpuProfilerScopes, 0 disables the profiler
+    void   init_gpu_profiler(uint32_t maxScopes);
+    void   destroy_gpu_profiler();
+    //reads back the current frame slot's previous timestamps and resets its pool.
+    //begin_frame calls this after waiting on the frame, so it never stalls
+    void   collect_gpu_profiler();
+
+    //times the commands recorded into cmd during its lifetime. scopes opened while another
+    //is open on the same thread become its children. no-op once the frame runs out of queries
+    //  {
+    //      GpuScope scope(cmd, "gbuffer");
+    //      begin_dynamic_rendering(...);
+    //      ...
+    //  }
+    struct GpuScope {
+        GpuScope(VkCommandBuffer cmd, const char* name);
+        ~GpuScope();
+        GpuScope(const GpuScope&)            = delete;
+        GpuScope& operator=(const GpuScope&) = delete;
+
+        VkCommandBuffer cmd;
+        uint32_t        index;
+        uint32_t        parent;
+    };
+
+    //the scope tree of the most recently completed frame, frameOverlap frames behind the cpu
+    const std::vector<GpuTiming>& gpu_timings();
+}
+
+#define SPOCK_GPU_CONCAT_(a, b) a##b
+#define SPOCK_GPU_CONCAT(a, b)  SPOCK_GPU_CONCAT_(a, b)
+#define SPOCK_GPU_SCOPE(cmd, name) spock::GpuScope SPOCK_GPU_CONCAT(gpuScope, __LINE__)(cmd, name)
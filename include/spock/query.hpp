@@ -0,0 +1,90 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace spock {
+    //hands out query slots from fixed size pools of one query type, creating pools on demand.
+    //one per frame in flight (FrameContext), so slots are only read back and reset once the frame has finished
+    struct QueryAllocator {
+        struct Slot {
+            VkQueryPool pool;
+            uint32_t    query;
+            uint32_t    index; //slot number this frame, indexes the read back results
+        };
+
+        VkQueryType                   type;
+        VkQueryPipelineStatisticFlags statistics     = 0;
+        uint32_t                      poolSize       = 0;
+        uint32_t                      valuesPerQuery = 1;
+
+        std::vector<VkQueryPool>      pools;
+        uint32_t                      used = 0;
+        std::vector<std::string>      names; //per used slot
+        std::vector<uint64_t>         ids;
+        std::mutex                    mutex;
+
+        void                          init(VkQueryType type, uint32_t poolSize, VkQueryPipelineStatisticFlags statistics = 0);
+        void                          destroy();
+        Slot                          allocate(const char* name, uint64_t id);
+        Slot                          slot(uint32_t index);
+        //reads every used slot into out, valuesPerQuery values each. returns false if some query
+        //never became available, e.g. because its frame wasn't submitted
+        bool                          read(std::vector<uint64_t>& out);
+        //host resets the used slots, one call per pool
+        void                          reset();
+    };
+
+    //the counters recorded by pipeline statistics queries, in VkQueryPipelineStatisticFlagBits order
+    struct PipelineStatistics {
+        uint64_t inputVertices;
+        uint64_t inputPrimitives;
+        uint64_t vertexInvocations;
+        uint64_t clippingInvocations;
+        uint64_t clippingPrimitives;
+        uint64_t fragmentInvocations;
+        uint64_t computeInvocations;
+    };
+
+    struct PipelineStatisticsResult {
+        std::string        name;
+        PipelineStatistics stats;
+    };
+
+    struct OcclusionResult {
+        uint64_t id;
+        uint64_t samples; //samples passed, only 0/non-0 is meaningful for non-precise queries
+    };
+
+    //creates the per-frame query allocators, called by init().
+    //pipeline statistics need the pipelineStatisticsQuery feature, without it those queries are no-ops
+    void                   init_queries();
+    void                   destroy_queries();
+    //reads the current frame's finished queries and resets them, called by begin_frame after its wait
+    void                   collect_queries();
+
+    //pipeline statistics around a pass, e.g. to attribute invocation counts. graphics queue command buffers only.
+    //returns a handle for end_pipeline_statistics, UINT32_MAX if unsupported
+    uint32_t               begin_pipeline_statistics(VkCommandBuffer cmd, const char* name);
+    void                   end_pipeline_statistics(VkCommandBuffer cmd, uint32_t handle);
+    //occlusion query tagged with a caller chosen id (e.g. an object index) to match the result later.
+    //precise counts samples and needs the occlusionQueryPrecise feature, otherwise it falls back to boolean
+    uint32_t               begin_occlusion_query(VkCommandBuffer cmd, uint64_t id, bool precise = false);
+    void                   end_occlusion_query(VkCommandBuffer cmd, uint32_t handle);
+
+    //results of the most recently completed frame, frameOverlap frames behind the cpu, in begin order
+    const std::vector<PipelineStatisticsResult>& pipeline_statistics_results();
+    const std::vector<OcclusionResult>&          occlusion_results();
+
+    struct PipelineStatisticsScope {
+        PipelineStatisticsScope(VkCommandBuffer cmd, const char* name) : cmd(cmd), handle(begin_pipeline_statistics(cmd, name)) {}
+        ~PipelineStatisticsScope() { end_pipeline_statistics(cmd, handle); }
+        PipelineStatisticsScope(const PipelineStatisticsScope&)            = delete;
+        PipelineStatisticsScope& operator=(const PipelineStatisticsScope&) = delete;
+
+        VkCommandBuffer cmd;
+        uint32_t        handle;
+    };
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+#include <initializer_list>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <vector>
+
+namespace spock {
+    //monotonically increasing gpu progress counter backed by a timeline semaphore.
+    //every submission made through spock::submit signals the next value, so
+    //"has the gpu finished work X" is a single integer comparison.
+    struct Timeline {
+        VkSemaphore           semaphore = VK_NULL_HANDLE;
+        std::atomic<uint64_t> value     = 0; //last value handed out to a submission
+        std::mutex            mutex;         //serialises value allocation with the queue submit
+
+        void                  init();
+        void                  destroy();
+        uint64_t              completed_value() const;
+        bool                  reached(uint64_t target) const;
+        void                  wait(uint64_t target) const;
+    };
+
+    //completion handle for submitted gpu work, can be polled or waited on.
+    //value 0 is complete from the start. a default constructed ticket is empty: it tracks no work,
+    //check valid() before relying on it
+    struct Ticket {
+        Timeline*             timeline = nullptr;
+        uint64_t              value    = 0;
+
+        bool                  valid() const { return timeline != nullptr; }
+
+        bool                  ready() const;
+        void                  wait() const;
+        //for making another queue's submission wait on this work on the gpu. an empty ticket gives a wait
+        //that is already satisfied, so it is harmless, but skip it when !valid()
+        VkSemaphoreSubmitInfo wait_info(VkPipelineStageFlags2 stageMask) const;
+    };
+
+    //command buffers that are recycled once their submission has completed on the gpu,
+    //so several one-off submissions can be in flight at once
+    struct CommandBufferPool {
+        struct Entry {
+            VkCommandBuffer cmd;
+            uint64_t        value; //timeline value of the last submit, RECORDING while acquired
+        };
+        static constexpr uint64_t RECORDING = UINT64_MAX;
+
+        VkCommandPool             pool     = VK_NULL_HANDLE;
+        Timeline*                 timeline = nullptr;
+        std::vector<Entry>        entries;
+        std::mutex                mutex;
+
+        void                      init(uint32_t queueFamily, Timeline* timeline);
+        void                      destroy();
+        //returns a reset command buffer, allocating a new one if all are still in flight
+        VkCommandBuffer           acquire();
+        //hands cmd back, it becomes reusable once the timeline reaches value
+        void                      release(VkCommandBuffer cmd, uint64_t value);
+    };
+
+    //submits cmd (may be VK_NULL_HANDLE) and signals the next timeline value, which is returned.
+    //waits/signals are extra semaphores, e.g. the binary swapchain semaphores.
+    uint64_t submit(VkQueue queue, Timeline& timeline, VkCommandBuffer cmd, std::initializer_list<VkSemaphoreSubmitInfo> waits = {},
+                    std::initializer_list<VkSemaphoreSubmitInfo> signals = {});
+    uint64_t submit(VkQueue queue, Timeline& timeline, VkCommandBuffer cmd, const VkSemaphoreSubmitInfo* waits, uint32_t waitCount,
+                    const VkSemaphoreSubmitInfo* signals, uint32_t signalCount);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+
+namespace spock {
+    //cpu event tracer. every thread records into its own fixed size buffer without locking,
+    //events past the buffer's capacity are dropped. names must outlive the trace (string literals).
+    //tracing is off by default, call trace_enable(true) to start recording
+    void     trace_enable(bool enable);
+    bool     trace_enabled();
+    uint64_t trace_now(); //nanoseconds, steady clock
+    void     trace_event(const char* name, uint64_t start, uint64_t end);
+    //writes all recorded events as chrome trace json (chrome://tracing, ui.perfetto.dev).
+    //call while no thread is recording, e.g. after startup or between frames
+    bool     trace_write(const char* path);
+    void     trace_clear();
+
+    struct TraceScope {
+        const char* name;
+        uint64_t    start;
+
+        TraceScope(const char* name) : name(name), start(trace_enabled() ? trace_now() : 0) {}
+        ~TraceScope() {
+            if (start != 0)
+                trace_event(name, start, trace_now());
+        }
+    };
+}
+
+#define SPOCK_TRACE_CONCAT_(a, b) a##b
+#define SPOCK_TRACE_CONCAT(a, b)  SPOCK_TRACE_CONCAT_(a, b)
+#define SPOCK_TRACE_SCOPE(name)   spock::TraceScope SPOCK_TRACE_CONCAT(traceScope, __LINE__)(name)
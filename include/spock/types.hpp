@@ -4,6 +4,24 @@
 #include <glm/glm.hpp>
 #include <vector>
 namespace spock {
+    //allocation category for memory statistics (memory.hpp)
+    enum class MemoryTag : uint8_t {
+        General,
+        Textures,
+        Meshes,
+        RenderTargets,
+        Staging,
+        Count,
+    };
+
+    //what a buffer is used for, create_buffer picks the memory type from it
+    enum class MemoryIntent {
+        DeviceOnly,        //only accessed by the gpu, filled through copies
+        Upload,            //written sequentially by the cpu (memcpy, no reads), read by the gpu. mapped
+        Readback,          //written by the gpu, read by the cpu. mapped and cached
+        DeviceHostVisible, //device local and mapped if the device has such memory (ReBAR/UMA), DeviceOnly otherwise
+    };
+
     struct Binding {
         uint32_t                 binding;
         VkDescriptorType         type;
@@ -0,0 +1,33 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+#include "types.hpp"
+#include "sync.hpp"
+
+namespace spock {
+    //staging memory for every upload comes from one persistently mapped ring of this size,
+    //created by init() (InitInfo::stagingRingSize). bigger uploads are split into chunks.
+    void   init_staging_ring(VkDeviceSize size);
+    void   destroy_staging_ring();
+
+    //upload batches record any number of buffer and image uploads into one submission.
+    //while a batch is open, copy_to_buffer and create_image(data, ...) join it instead of submitting on their own.
+    //  begin_upload_batch();
+    //  for (...) create_image(file, ...);
+    //  Ticket t = end_upload_batch();
+    //batches run on ctx.transferQueue. with a dedicated transfer family the queue family ownership
+    //release/acquire barriers are inserted automatically and the returned ticket is the graphics
+    //timeline value after the acquire, so graphics work submitted later needs no extra wait and
+    //other queues can wait on ticket.wait_info().
+    void   begin_upload_batch();
+    Ticket end_upload_batch();
+    bool   upload_batch_open();
+
+    //queue uploads into the open batch. src is copied into staging memory immediately,
+    //image uploads transition the image to SHADER_READ_ONLY_OPTIMAL.
+    //with a dedicated transfer family, create_buffer makes buffers VK_SHARING_MODE_CONCURRENT across graphics
+    //and transfer, so buffer uploads need no ownership transfer. buffers created elsewhere must be concurrent too.
+    //batches with buffer uploads wait for the graphics work submitted before them, so updating a buffer that
+    //frames in flight still read is safe
+    void   upload_buffer(VkBuffer dst, const void* src, VkDeviceSize dstOffset, VkDeviceSize size);
+    void   upload_image(const Image& image, const void* src, VkDeviceSize size);
+}
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "spock/bindless.hpp"
+#include "spock/core.hpp"
+#include "spock/internal.hpp"
+#include "spock/util.hpp"
+
+using namespace spock;
+
+constexpr uint32_t BINDLESS_TYPE_COUNT = (uint32_t)BindlessType::Count;
+
+constexpr VkDescriptorType DESCRIPTOR_TYPES[BINDLESS_TYPE_COUNT] = {
+    VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+    VK_DESCRIPTOR_TYPE_SAMPLER,
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+};
+
+struct IndexAllocator {
+    uint32_t              capacity = 0;
+    uint32_t              next     = 0; //never handed out past this
+    std::vector<uint32_t> free;
+    //unregistered during the frame being recorded, not covered by any submitted timeline value yet
+    std::vector<uint32_t> released;
+    //released indices, reusable once both timelines reach the values
+    struct Pending {
+        uint64_t graphicsValue;
+        uint64_t computeValue;
+        uint32_t index;
+    };
+    std::deque<Pending> pending;
+};
+
+static struct BindlessRegistry {
+    VkDescriptorPool      pool   = VK_NULL_HANDLE;
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    VkDescriptorSet       set    = VK_NULL_HANDLE;
+    IndexAllocator        indices[BINDLESS_TYPE_COUNT];
+    //guards the index lists and writes to the set
+    std::mutex            mutex;
+} registry;
+
+void spock::init_bindless(const BindlessCounts& counts) {
+    VkPhysicalDeviceVulkan12Properties props12{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES};
+    VkPhysicalDeviceProperties2        props{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &props12};
+    vkGetPhysicalDeviceProperties2(ctx.physicalDevice, &props);
+
+    uint32_t capacity[BINDLESS_TYPE_COUNT] = {
+        std::min({counts.sampledImages, props12.maxDescriptorSetUpdateAfterBindSampledImages, props12.maxPerStageDescriptorUpdateAfterBindSampledImages}),
+        std::min({counts.storageImages, props12.maxDescriptorSetUpdateAfterBindStorageImages, props12.maxPerStageDescriptorUpdateAfterBindStorageImages}),
+        std::min({counts.samplers, props12.maxDescriptorSetUpdateAfterBindSamplers, props12.maxPerStageDescriptorUpdateAfterBindSamplers}),
+        std::min({counts.storageBuffers, props12.maxDescriptorSetUpdateAfterBindStorageBuffers, props12.maxPerStageDescriptorUpdateAfterBindStorageBuffers}),
+    };
+
+    VkDescriptorSetLayoutBinding bindings[BINDLESS_TYPE_COUNT];
+    VkDescriptorBindingFlags     bindingFlags[BINDLESS_TYPE_COUNT];
+    VkDescriptorPoolSize         poolSizes[BINDLESS_TYPE_COUNT];
+    for (uint32_t i = 0; i < BINDLESS_TYPE_COUNT; i++) {
+        //at least one descriptor, zero sized bindings are reserved but unusable
+        capacity[i]                  = std::max(capacity[i], 1u);
+        registry.indices[i]          = {};
+        registry.indices[i].capacity = capacity[i];
+        bindings[i] = {.binding = i, .descriptorType = DESCRIPTOR_TYPES[i], .descriptorCount = capacity[i], .stageFlags = VK_SHADER_STAGE_ALL};
+        //unregistered slots are never written, registering only touches slots no pending work uses
+        bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                          VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+        poolSizes[i] = {.type = DESCRIPTOR_TYPES[i], .descriptorCount = capacity[i]};
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+    flagsInfo.bindingCount  = BINDLESS_TYPE_COUNT;
+    flagsInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.pNext        = &flagsInfo;
+    layoutInfo.flags        = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = BINDLESS_TYPE_COUNT;
+    layoutInfo.pBindings    = bindings;
+    VK_CHECK(vkCreateDescriptorSetLayout(ctx.device, &layoutInfo, nullptr, &registry.layout));
+
+    VkDescriptorPoolCreateInfo poolInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.flags         = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets       = 1;
+    poolInfo.poolSizeCount = BINDLESS_TYPE_COUNT;
+    poolInfo.pPoolSizes    = poolSizes;
+    VK_CHECK(vkCreateDescriptorPool(ctx.device, &poolInfo, nullptr, &registry.pool));
+
+    VkDescriptorSetAllocateInfo allocInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool     = registry.pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts        = &registry.layout;
+    VK_CHECK(vkAllocateDescriptorSets(ctx.device, &allocInfo, &registry.set));
+}
+
+void spock::destroy_bindless() {
+    vkDestroyDescriptorPool(ctx.device, registry.pool, nullptr);
+    vkDestroyDescriptorSetLayout(ctx.device, registry.layout, nullptr);
+    registry.pool   = VK_NULL_HANDLE;
+    registry.layout = VK_NULL_HANDLE;
+    registry.set    = VK_NULL_HANDLE;
+}
+
+void spock::collect_bindless() {
+    uint64_t                    graphics = ctx.timeline.completed_value();
+    uint64_t                    compute  = compute_timeline().completed_value();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (auto& indices : registry.indices) {
+        while (!indices.pending.empty() && indices.pending.front().graphicsValue <= graphics && indices.pending.front().computeValue <= compute) {
+            indices.free.push_back(indices.pending.front().index);
+            indices.pending.pop_front();
+        }
+        //the previous frame, which may have used them, is submitted by now. wait for it and everything before it
+        for (uint32_t index : indices.released) {
+            indices.pending.push_back({ctx.timeline.value, compute_timeline().value, index});
+        }
+        indices.released.clear();
+    }
+}
+
+VkDescriptorSetLayout spock::bindless_layout() {
+    return registry.layout;
+}
+
+VkDescriptorSet spock::bindless_set() {
+    return registry.set;
+}
+
+void spock::bind_bindless(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t setIndex) {
+    vkCmdBindDescriptorSets(cmd, bindPoint, layout, setIndex, 1, &registry.set, 0, nullptr);
+}
+
+//call with the mutex held
+static uint32_t allocate_index(BindlessType type) {
+    IndexAllocator& indices = registry.indices[(uint32_t)type];
+    if (!indices.free.empty()) {
+        uint32_t index = indices.free.back();
+        indices.free.pop_back();
+        return index;
+    }
+    //out of slots, raise the matching InitInfo::bindless count
+    if (indices.next >= indices.capacity) {
+        printf("Out of bindless slots for binding %u (capacity %u)\n", (uint32_t)type, indices.capacity);
+        abort();
+    }
+    return indices.next++;
+}
+
+static uint32_t register_descriptor(BindlessType type, const VkDescriptorImageInfo* imageInfo, const VkDescriptorBufferInfo* bufferInfo) {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    uint32_t                    index = allocate_index(type);
+
+    VkWriteDescriptorSet        write{.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet          = registry.set;
+    write.dstBinding      = (uint32_t)type;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType  = DESCRIPTOR_TYPES[(uint32_t)type];
+    write.pImageInfo      = imageInfo;
+    write.pBufferInfo     = bufferInfo;
+    vkUpdateDescriptorSets(ctx.device, 1, &write, 0, nullptr);
+    return index;
+}
+
+uint32_t spock::register_sampled_image(VkImageView view, VkImageLayout layout) {
+    VkDescriptorImageInfo imageInfo{.imageView = view, .imageLayout = layout};
+    return register_descriptor(BindlessType::SampledImage, &imageInfo, nullptr);
+}
+
+uint32_t spock::register_storage_image(VkImageView view, VkImageLayout layout) {
+    VkDescriptorImageInfo imageInfo{.imageView = view, .imageLayout = layout};
+    return register_descriptor(BindlessType::StorageImage, &imageInfo, nullptr);
+}
+
+uint32_t spock::register_sampler(VkSampler sampler) {
+    VkDescriptorImageInfo imageInfo{.sampler = sampler};
+    return register_descriptor(BindlessType::Sampler, &imageInfo, nullptr);
+}
+
+uint32_t spock::register_storage_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    VkDescriptorBufferInfo bufferInfo{.buffer = buffer, .offset = offset, .range = range};
+    return register_descriptor(BindlessType::StorageBuffer, nullptr, &bufferInfo);
+}
+
+void spock::unregister_bindless(BindlessType type, uint32_t index) {
+    //draws recorded earlier in this frame may still index it, and they aren't submitted yet.
+    //collect_bindless keys it on the timeline values once this frame has been submitted
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.indices[(uint32_t)type].released.push_back(index);
+}
@@ -1,4 +1,7 @@
 #include <vulkan/vulkan_core.h>
+#include <algorithm>
+#include <cstring>
+#include <thread>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
@@ -18,6 +21,15 @@
 #include "spock/internal.hpp"
 #include "spock/destroy.hpp"
 #include "spock/shader.hpp"
+#include "spock/upload.hpp"
+#include "spock/profiler.hpp"
+#include "spock/query.hpp"
+#include "spock/trace.hpp"
+#include "spock/memory.hpp"
+#include "spock/layout_cache.hpp"
+#include "spock/descriptor_buffer.hpp"
+#include "spock/pipeline_cache.hpp"
+#include "spock/pipeline_builder.hpp"
 #include "spock/util.hpp"
 
 #ifdef DBG
@@ -36,10 +48,30 @@ static void destroy_swapchain() {
 }
 
 static void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
+    //recreation is deferred to the next acquire, so a drag resize doesn't rebuild the swapchain per event
     ctx.windowExtent.width  = width;
     ctx.windowExtent.height = height;
-    destroy_swapchain();
-    create_swapchain(width, height);
+    ctx.swapchainDirty      = true;
+    ctx.lastResizeTime      = glfwGetTime();
+}
+
+static bool recreate_swapchain() {
+    //minimised, keep presenting to nothing until there is an area again
+    if (ctx.windowExtent.width == 0 || ctx.windowExtent.height == 0)
+        return false;
+
+    //the old swapchain is retired by create_swapchain. its last presents were queued after the last
+    //timeline signal and aren't tracked by it, so wait for the queue before destroying it.
+    //rare (debounced resizes), a stall is fine here
+    RenderContext::Swapchain old = ctx.swapchain;
+    create_swapchain(ctx.windowExtent.width, ctx.windowExtent.height);
+    VK_CHECK(vkQueueWaitIdle(ctx.graphicsQueue));
+    for (const auto& iv : old.imageViews) {
+        vkDestroyImageView(ctx.device, iv, nullptr);
+    }
+    vkDestroySwapchainKHR(ctx.device, old.swapchain, nullptr);
+    ctx.swapchainDirty = false;
+    return true;
 }
 
 void error_exit() {
@@ -65,26 +97,32 @@ static void init_glfw_window() {
 }
 
 static void init_device() {
-    uint32_t             count;
-    const char**         extensions = glfwGetRequiredInstanceExtensions(&count);
-
     vkb::InstanceBuilder builder;
-    auto                 inst_ret = builder.set_app_name("vulkan app")
-                        .request_validation_layers(gEnableValidationLayers)
-                        .use_default_debug_messenger()
-                        .require_api_version(1, 3, 0)
-                        .enable_extensions(count, extensions)
-                        .build();
-
-    vkb::Instance vkb_inst = inst_ret.value();
+    builder.set_app_name("vulkan app")
+        .request_validation_layers(gEnableValidationLayers)
+        .use_default_debug_messenger()
+        .require_api_version(1, 3, 0);
+
+    if (ctx.headless) {
+        //no surface extensions, so this works without a display (e.g. lavapipe on ci)
+        builder.set_headless();
+    } else {
+        uint32_t     count;
+        const char** extensions = glfwGetRequiredInstanceExtensions(&count);
+        builder.enable_extensions(count, extensions);
+    }
+
+    vkb::Instance vkb_inst = builder.build().value();
     ctx.instance           = vkb_inst.instance;
     ctx.debugMessenger     = vkb_inst.debug_messenger;
 
-    //glfw function pointers
-    PFN_vkCreateInstance    pfnCreateInstance    = (PFN_vkCreateInstance)glfwGetInstanceProcAddress(NULL, "vkCreateInstance");
-    PFN_vkCreateDevice      pfnCreateDevice      = (PFN_vkCreateDevice)glfwGetInstanceProcAddress(ctx.instance, "vkCreateDevice");
-    PFN_vkGetDeviceProcAddr pfnGetDeviceProcAddr = (PFN_vkGetDeviceProcAddr)glfwGetInstanceProcAddress(ctx.instance, "vkGetDeviceProcAddr");
-    VK_CHECK(glfwCreateWindowSurface(ctx.instance, ctx.window, nullptr, &ctx.surface));
+    if (!ctx.headless) {
+        //glfw function pointers
+        PFN_vkCreateInstance    pfnCreateInstance    = (PFN_vkCreateInstance)glfwGetInstanceProcAddress(NULL, "vkCreateInstance");
+        PFN_vkCreateDevice      pfnCreateDevice      = (PFN_vkCreateDevice)glfwGetInstanceProcAddress(ctx.instance, "vkCreateDevice");
+        PFN_vkGetDeviceProcAddr pfnGetDeviceProcAddr = (PFN_vkGetDeviceProcAddr)glfwGetInstanceProcAddress(ctx.instance, "vkGetDeviceProcAddr");
+        VK_CHECK(glfwCreateWindowSurface(ctx.instance, ctx.window, nullptr, &ctx.surface));
+    }
 
     //vulkan 1.3 features
     VkPhysicalDeviceVulkan13Features features13{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
@@ -95,6 +133,8 @@ static void init_device() {
     features12.bufferDeviceAddress                           = true;
     features12.shaderOutputViewportIndex                     = true;
     features12.shaderOutputLayer                     = true;
+    features12.timelineSemaphore                             = true;
+    features12.hostQueryReset                                = true;
     features12.descriptorIndexing                            = true;
     features12.runtimeDescriptorArray                        = true;
     features12.shaderUniformBufferArrayNonUniformIndexing    = true;
@@ -105,6 +145,8 @@ static void init_device() {
     features12.descriptorBindingSampledImageUpdateAfterBind  = true;
     features12.descriptorBindingStorageBufferUpdateAfterBind = true;
     features12.descriptorBindingStorageImageUpdateAfterBind  = true;
+    features12.descriptorBindingPartiallyBound               = true;
+    features12.descriptorBindingUpdateUnusedWhilePending     = true;
 
     VkPhysicalDeviceVulkan11Features features11{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES};
     features11.multiview = true;
@@ -113,27 +155,115 @@ static void init_device() {
     features10.fillModeNonSolid = true;
 
     vkb::PhysicalDeviceSelector selector{vkb_inst};
-    vkb::PhysicalDevice         physical_device = selector
-        .set_minimum_version(1, 3)
+    selector.set_minimum_version(1, 3)
         .set_required_features(features10)
         .set_required_features_13(features13)
         .set_required_features_12(features12)
-        .set_required_features_11(features11)
-        .set_surface(ctx.surface).select().value();
+        .set_required_features_11(features11);
+    //headless instances don't require present support
+    if (!ctx.headless)
+        selector.set_surface(ctx.surface);
+    vkb::PhysicalDevice physical_device = selector.select().value();
+
+    //optional query features, enabled when supported
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physical_device.physical_device, &supportedFeatures);
+    physical_device.features.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+    physical_device.features.occlusionQueryPrecise   = supportedFeatures.occlusionQueryPrecise;
+    ctx.pipelineStatisticsQuery                      = supportedFeatures.pipelineStatisticsQuery;
+    ctx.occlusionQueryPrecise                        = supportedFeatures.occlusionQueryPrecise;
+
+    //present id/wait let the cpu pace itself to actual presentation, optional
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR};
+    VkPhysicalDevicePresentIdFeaturesKHR   presentIdFeatures{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR};
+    ctx.presentWaitSupported = false;
+    if (!ctx.headless && physical_device.enable_extensions_if_present({VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME})) {
+        presentIdFeatures.pNext = &presentWaitFeatures;
+        VkPhysicalDeviceFeatures2 features2{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &presentIdFeatures};
+        vkGetPhysicalDeviceFeatures2(physical_device.physical_device, &features2);
+        ctx.presentWaitSupported = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+        presentIdFeatures.pNext  = nullptr;
+    }
+
+    //descriptor buffers on request
+    VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT};
+    bool                                        descriptorBufferRequested = ctx.descriptorBuffer;
+    ctx.descriptorBuffer                                                  = false;
+    if (descriptorBufferRequested && physical_device.enable_extension_if_present(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME)) {
+        VkPhysicalDeviceFeatures2 features2{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &descriptorBufferFeatures};
+        vkGetPhysicalDeviceFeatures2(physical_device.physical_device, &features2);
+        ctx.descriptorBuffer = descriptorBufferFeatures.descriptorBuffer;
+        //only the base feature is used
+        descriptorBufferFeatures = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT, .descriptorBuffer = VK_TRUE};
+    }
+
+    //exact heap budgets instead of vma's estimate
+    bool memoryBudget   = physical_device.enable_extension_if_present(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    ctx.pushDescriptors = physical_device.enable_extension_if_present(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
 
     vkb::DeviceBuilder device_builder{physical_device};
+    if (ctx.presentWaitSupported) {
+        device_builder.add_pNext(&presentIdFeatures);
+        device_builder.add_pNext(&presentWaitFeatures);
+    }
+    if (ctx.descriptorBuffer)
+        device_builder.add_pNext(&descriptorBufferFeatures);
     vkb::Device        vkb_device = device_builder.build().value();
     ctx.device                    = vkb_device.device;
     ctx.graphicsQueue             = vkb_device.get_queue(vkb::QueueType::graphics).value();
     ctx.graphicsQueueFamily       = vkb_device.get_queue_index(vkb::QueueType::graphics).value();
     ctx.physicalDevice            = physical_device.physical_device;
+    if (ctx.presentWaitSupported)
+        ctx.pfnWaitForPresent = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(ctx.device, "vkWaitForPresentKHR");
+    if (ctx.pushDescriptors) {
+        ctx.pfnCmdPushDescriptorSet = (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(ctx.device, "vkCmdPushDescriptorSetKHR");
+        ctx.pfnCmdPushDescriptorSetWithTemplate =
+            (PFN_vkCmdPushDescriptorSetWithTemplateKHR)vkGetDeviceProcAddr(ctx.device, "vkCmdPushDescriptorSetWithTemplateKHR");
+    }
+
+    //uploads go to a dedicated transfer queue when the device has one, otherwise they share the graphics queue
+    auto transferQueue = vkb_device.get_dedicated_queue(vkb::QueueType::transfer);
+    if (transferQueue.has_value()) {
+        ctx.transferQueue       = transferQueue.value();
+        ctx.transferQueueFamily = vkb_device.get_dedicated_queue_index(vkb::QueueType::transfer).value();
+        ctx.dedicatedTransfer   = true;
+    } else {
+        ctx.transferQueue       = ctx.graphicsQueue;
+        ctx.transferQueueFamily = ctx.graphicsQueueFamily;
+        ctx.dedicatedTransfer   = false;
+    }
+
+    //async compute runs on a compute family without graphics, if there is one
+    auto computeQueue = vkb_device.get_queue(vkb::QueueType::compute);
+    if (computeQueue.has_value()) {
+        ctx.computeQueue       = computeQueue.value();
+        ctx.computeQueueFamily = vkb_device.get_queue_index(vkb::QueueType::compute).value();
+        ctx.asyncCompute       = true;
+    } else {
+        ctx.computeQueue       = ctx.graphicsQueue;
+        ctx.computeQueueFamily = ctx.graphicsQueueFamily;
+        ctx.asyncCompute       = false;
+    }
 
     VmaAllocatorCreateInfo allocatorInfo = {};
     allocatorInfo.physicalDevice         = ctx.physicalDevice;
     allocatorInfo.device                 = ctx.device;
     allocatorInfo.instance               = ctx.instance;
     allocatorInfo.flags                  = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+    if (memoryBudget)
+        allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
     vmaCreateAllocator(&allocatorInfo, &ctx.allocator);
+
+    //the legacy bar window is 256MB, anything bigger means the cpu can map all of vram
+    const VkPhysicalDeviceMemoryProperties* memProps;
+    vmaGetMemoryProperties(ctx.allocator, &memProps);
+    ctx.deviceLocalHostVisible = false;
+    for (uint32_t i = 0; i < memProps->memoryTypeCount; i++) {
+        VkMemoryPropertyFlags flags = memProps->memoryTypes[i].propertyFlags;
+        if ((flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) && (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+            memProps->memoryHeaps[memProps->memoryTypes[i].heapIndex].size > 256ull * 1024 * 1024)
+            ctx.deviceLocalHostVisible = true;
+    }
     QUEUE_DESTROY_OBJ(ctx.allocator);
 }
 
@@ -142,45 +272,256 @@ static void init_swapchain() {
     create_swapchain(ctx.windowExtent.width, ctx.windowExtent.height);
 }
 
-void init_commands() {
+static void init_offscreen_targets(VkExtent2D extent, VkFormat format) {
+    //headless replacement for the swapchain images, one per frame in flight
+    ctx.windowExtent = extent;
+    ctx.offscreenImages.resize(ctx.frameOverlap);
+    for (auto& image : ctx.offscreenImages) {
+        image = create_image(extent, format,
+                             VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                             VK_IMAGE_VIEW_TYPE_2D, false, MemoryTag::RenderTargets);
+        QUEUE_DESTROY_OBJ(image);
+        QUEUE_DESTROY_OBJ(image.imageView);
+    }
+}
+
+void init_commands(uint32_t recordingThreads) {
     //create frame command pools
     auto commandPoolInfo = info::create::command_pool(ctx.graphicsQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
-    for (int i = 0; i < FRAME_OVERLAP; i++) {
-        VK_CHECK(vkCreateCommandPool(ctx.device, &commandPoolInfo, nullptr, &ctx.frames[i].commandPool));
-        VkCommandBufferAllocateInfo cmdAllocInfo = info::allocate::command_buffer(ctx.frames[i].commandPool, 1);
-        VK_CHECK(vkAllocateCommandBuffers(ctx.device, &cmdAllocInfo, &ctx.frames[i].commandBuffer));
+    for (auto& frame : ctx.frames) {
+        VK_CHECK(vkCreateCommandPool(ctx.device, &commandPoolInfo, nullptr, &frame.commandPool));
+        VkCommandBufferAllocateInfo cmdAllocInfo = info::allocate::command_buffer(frame.commandPool, 1);
+        VK_CHECK(vkAllocateCommandBuffers(ctx.device, &cmdAllocInfo, &frame.commandBuffer));
+    }
+
+    auto computePoolInfo = info::create::command_pool(ctx.computeQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    for (auto& frame : ctx.frames) {
+        VK_CHECK(vkCreateCommandPool(ctx.device, &computePoolInfo, nullptr, &frame.computeCommandPool));
+        VkCommandBufferAllocateInfo cmdAllocInfo = info::allocate::command_buffer(frame.computeCommandPool, 1);
+        VK_CHECK(vkAllocateCommandBuffers(ctx.device, &cmdAllocInfo, &frame.computeCommandBuffer));
     }
 
-    VK_CHECK(vkCreateCommandPool(ctx.device, &commandPoolInfo, nullptr, &ctx.immCommandPool));
-    VkCommandBufferAllocateInfo cmdAllocInfo = info::allocate::command_buffer(ctx.immCommandPool, 1);
-    VK_CHECK(vkAllocateCommandBuffers(ctx.device, &cmdAllocInfo, &ctx.immCommandBuffer));
-    QUEUE_DESTROY_OBJ(ctx.immCommandPool);
+    //secondaries are reset a whole pool at a time
+    auto threadPoolInfo = info::create::command_pool(ctx.graphicsQueueFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+    for (auto& frame : ctx.frames) {
+        frame.threadCommands.resize(recordingThreads);
+        for (auto& t : frame.threadCommands) {
+            VK_CHECK(vkCreateCommandPool(ctx.device, &threadPoolInfo, nullptr, &t.pool));
+        }
+    }
+
+    ctx.immCommands.init(ctx.graphicsQueueFamily, &ctx.timeline);
+    if (ctx.dedicatedTransfer)
+        ctx.transferCommands.init(ctx.transferQueueFamily, &ctx.transferTimeline);
 }
 
 static void init_synchronization() {
     //create synchronization structures
-    VkFenceCreateInfo     fence     = info::create::fence(VK_FENCE_CREATE_SIGNALED_BIT);
+    //binary semaphores are only used for swapchain acquire/present, everything else waits on the timeline
     VkSemaphoreCreateInfo semaphore = info::create::semaphore();
 
-    for (int i = 0; i < FRAME_OVERLAP; i++) {
-        VK_CHECK(vkCreateFence(ctx.device, &fence, nullptr, &ctx.frames[i].renderFence));
-        VK_CHECK(vkCreateSemaphore(ctx.device, &semaphore, nullptr, &ctx.frames[i].swapchainSemaphore));
-        VK_CHECK(vkCreateSemaphore(ctx.device, &semaphore, nullptr, &ctx.frames[i].renderSemaphore));
+    for (auto& frame : ctx.frames) {
+        VK_CHECK(vkCreateSemaphore(ctx.device, &semaphore, nullptr, &frame.swapchainSemaphore));
+        VK_CHECK(vkCreateSemaphore(ctx.device, &semaphore, nullptr, &frame.renderSemaphore));
+        frame.timelineValue        = 0;
+        frame.computeTimelineValue = 0;
     }
-    VK_CHECK(vkCreateFence(ctx.device, &fence, nullptr, &ctx.immCommandFence));
-    QUEUE_DESTROY_OBJ(ctx.immCommandFence);
+    ctx.timeline.init();
+    if (ctx.dedicatedTransfer)
+        ctx.transferTimeline.init();
+    if (ctx.asyncCompute)
+        ctx.computeTimeline.init();
 }
 
-void spock::init() {
-    init_glfw_window();
+void spock::init(const InitInfo& info) {
+    ctx.frameOverlap     = info.frameOverlap > 0 ? info.frameOverlap : 1;
+    //FrameContext isn't movable, build the vector in place
+    ctx.frames           = std::vector<FrameContext>(ctx.frameOverlap);
+    ctx.frameIdx         = 0;
+    ctx.headless         = info.headless;
+    ctx.resizeDebounce   = info.resizeDebounce;
+    ctx.presentMode      = info.presentMode;
+    ctx.minImageCount    = info.swapchainImageCount;
+    ctx.presentLatency   = info.presentLatency;
+    ctx.descriptorBuffer = info.descriptorBuffer; //cleared by init_device if unsupported
+
+    if (!ctx.headless)
+        init_glfw_window();
     init_device();
-    init_swapchain();
-    init_commands();
+    if (ctx.headless)
+        init_offscreen_targets(info.offscreenExtent, info.offscreenFormat);
+    else
+        init_swapchain();
+    uint32_t recordingThreads = info.recordingThreads > 0 ? info.recordingThreads : std::max(std::thread::hardware_concurrency(), 1u);
+    init_commands(recordingThreads);
     init_synchronization();
+    init_staging_ring(info.stagingRingSize);
+    init_gpu_profiler(info.gpuProfilerScopes);
+    init_queries();
+    for (auto& frame : ctx.frames) {
+        frame.linearAllocator.init(info.frameAllocatorSize);
+    }
+    init_bindless(info.bindless);
+    init_descriptor_buffers();
+    init_pipeline_cache(info.pipelineCachePath);
     
     ctx.initialised = true;
 }
 
+FrameContext& spock::begin_frame() {
+    FrameContext& frame = get_frame();
+    //low latency: don't start recording until recent frames actually reached the screen
+    if (!ctx.headless && ctx.presentLatency > 0)
+        wait_for_present(ctx.presentLatency);
+    //only blocks if the gpu is more than frameOverlap frames behind
+    ctx.timeline.wait(frame.timelineValue);
+    compute_timeline().wait(frame.computeTimelineValue);
+
+    collect_gpu_profiler();
+    collect_queries();
+    update_memory_budget();
+    frame.linearAllocator.reset();
+    collect_bindless();
+    frame.destroyQueue.flush();
+    frame.descriptorAllocator.clear_pools();
+    destroyQueue.collect(ctx.timeline.completed_value());
+    VK_CHECK(vkResetCommandBuffer(frame.commandBuffer, 0));
+    VK_CHECK(vkResetCommandBuffer(frame.computeCommandBuffer, 0));
+    for (auto& t : frame.threadCommands) {
+        if (t.used > 0)
+            VK_CHECK(vkResetCommandPool(ctx.device, t.pool, 0));
+        t.used = 0;
+    }
+    return frame;
+}
+
+static VkCommandBuffer next_secondary(uint32_t threadIdx) {
+    ThreadCommands& t = get_frame().threadCommands[threadIdx];
+    if (t.used == t.secondaries.size()) {
+        VkCommandBuffer             cmd;
+        VkCommandBufferAllocateInfo cmdAllocInfo = info::allocate::command_buffer(t.pool, 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+        VK_CHECK(vkAllocateCommandBuffers(ctx.device, &cmdAllocInfo, &cmd));
+        t.secondaries.push_back(cmd);
+    }
+    return t.secondaries[t.used++];
+}
+
+VkCommandBuffer spock::begin_secondary_command(uint32_t threadIdx, std::initializer_list<VkFormat> colorFormats, VkFormat depthFormat, VkFormat stencilFormat,
+                                               VkSampleCountFlagBits samples, uint32_t viewMask) {
+    VkCommandBuffer cmd = next_secondary(threadIdx);
+
+    VkCommandBufferInheritanceRenderingInfo renderingInfo = {.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO};
+    renderingInfo.flags                                   = 0; //must match the primary's flags minus CONTENTS_SECONDARY
+    renderingInfo.viewMask                                = viewMask;
+    renderingInfo.colorAttachmentCount                    = uint32_t(colorFormats.size());
+    renderingInfo.pColorAttachmentFormats                 = std::data(colorFormats);
+    renderingInfo.depthAttachmentFormat                   = depthFormat;
+    renderingInfo.stencilAttachmentFormat                 = stencilFormat;
+    renderingInfo.rasterizationSamples                    = samples;
+
+    VkCommandBufferInheritanceInfo inheritance = {.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+    inheritance.pNext                          = &renderingInfo;
+
+    VkCommandBufferBeginInfo beginInfo = info::begin::command_buffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+    beginInfo.pInheritanceInfo         = &inheritance;
+    VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+    return cmd;
+}
+
+VkCommandBuffer spock::begin_secondary_command(uint32_t threadIdx) {
+    VkCommandBuffer cmd = next_secondary(threadIdx);
+
+    VkCommandBufferInheritanceInfo inheritance = {.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+    VkCommandBufferBeginInfo       beginInfo   = info::begin::command_buffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    beginInfo.pInheritanceInfo                 = &inheritance;
+    VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+    return cmd;
+}
+
+void spock::end_secondary_command(VkCommandBuffer cmd) {
+    VK_CHECK(vkEndCommandBuffer(cmd));
+}
+
+void spock::execute_secondary_commands(VkCommandBuffer primary, const VkCommandBuffer* cmds, uint32_t count) {
+    if (count > 0)
+        vkCmdExecuteCommands(primary, count, cmds);
+}
+
+uint64_t spock::submit_frame(FrameContext& frame, std::initializer_list<VkSemaphoreSubmitInfo> waits) {
+    //max 8 extra waits
+    assert(waits.size() < 8);
+    VkSemaphoreSubmitInfo waitInfos[8];
+    uint32_t              waitCount = 0;
+    for (auto& w : waits) {
+        waitInfos[waitCount++] = w;
+    }
+
+    frame.linearAllocator.flush();
+
+    //nothing to acquire or present without a swapchain
+    if (ctx.headless) {
+        frame.timelineValue = submit(ctx.graphicsQueue, ctx.timeline, frame.commandBuffer, waitInfos, waitCount, nullptr, 0);
+        return frame.timelineValue;
+    }
+
+    waitInfos[waitCount++]       = info::submit::semaphore(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, frame.swapchainSemaphore);
+    VkSemaphoreSubmitInfo signal = info::submit::semaphore(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, frame.renderSemaphore);
+    frame.timelineValue          = submit(ctx.graphicsQueue, ctx.timeline, frame.commandBuffer, waitInfos, waitCount, &signal, 1);
+    return frame.timelineValue;
+}
+
+bool spock::acquire_swapchain_image(FrameContext& frame, uint32_t& imageIndex) {
+    if (ctx.swapchainDirty && glfwGetTime() - ctx.lastResizeTime >= ctx.resizeDebounce)
+        recreate_swapchain();
+    if (ctx.windowExtent.width == 0 || ctx.windowExtent.height == 0)
+        return false;
+
+    VkResult result = vkAcquireNextImageKHR(ctx.device, ctx.swapchain.swapchain, UINT64_MAX, frame.swapchainSemaphore, VK_NULL_HANDLE, &imageIndex);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        //can't render to this swapchain at all, skip the frame
+        recreate_swapchain();
+        return false;
+    }
+    //still presentable, recreate at the next frame boundary
+    if (result == VK_SUBOPTIMAL_KHR)
+        ctx.swapchainDirty = true;
+    return result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR;
+}
+
+void spock::present_frame(FrameContext& frame, uint32_t imageIndex) {
+    VkPresentInfoKHR presentInfo = info::present(&ctx.swapchain.swapchain, &frame.renderSemaphore, &imageIndex);
+
+    uint64_t         presentId   = ++ctx.presentId;
+    VkPresentIdKHR   presentIdInfo{.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR, .swapchainCount = 1, .pPresentIds = &presentId};
+    if (ctx.presentWaitSupported)
+        presentInfo.pNext = &presentIdInfo;
+
+    VkResult         result      = vkQueuePresentKHR(ctx.graphicsQueue, &presentInfo);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+        ctx.swapchainDirty = true;
+}
+
+void spock::set_present_mode(VkPresentModeKHR mode) {
+    ctx.presentMode    = mode;
+    ctx.swapchainDirty = true;
+}
+
+void spock::wait_for_present(uint32_t framesBehind) {
+    if (!ctx.presentWaitSupported || ctx.presentId < framesBehind)
+        return;
+    uint64_t target = ctx.presentId - framesBehind;
+    if (target < ctx.swapchainFirstPresentId)
+        return;
+    //bounded so a hidden window can't hang the frame loop, out of date is picked up by the next acquire
+    ctx.pfnWaitForPresent(ctx.device, ctx.swapchain.swapchain, target, 100'000'000);
+}
+
+Ticket spock::submit_frame_compute(FrameContext& frame, std::initializer_list<VkSemaphoreSubmitInfo> waits) {
+    frame.linearAllocator.flush();
+    frame.computeTimelineValue = submit(ctx.computeQueue, compute_timeline(), frame.computeCommandBuffer, waits);
+    return {&compute_timeline(), frame.computeTimelineValue};
+}
+
 void spock::clean_init() {
     clean_shader_modules();
 }
@@ -193,180 +534,257 @@ VkDescriptorSetLayout spock::create_descriptor_set_layout(std::initializer_list<
         bindingFlags.push_back(b.flags);
     }
 
-    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_info = {.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
-    binding_info.bindingCount = bindingFlags.size();
-    binding_info.pBindingFlags = bindingFlags.data();
-
-    VkDescriptorSetLayoutCreateInfo info = {.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
-    info.pNext                           = &binding_info;
-    info.pBindings                       = bindings.data();
-    info.bindingCount                    = bindings.size();
-    info.flags                           = flags;
-
-    VkDescriptorSetLayout set;
-    VK_CHECK(vkCreateDescriptorSetLayout(ctx.device, &info, nullptr, &set));
-    QUEUE_DESTROY_OBJ(set);
-
-    return set;
+    //identical layouts share one handle, owned by the cache
+    return cached_descriptor_set_layout(bindings.data(), bindingFlags.data(), bindings.size(), flags);
 }
 
 VkPipelineLayout      spock::create_pipeline_layout(std::initializer_list<VkDescriptorSetLayout> dsLayouts, std::initializer_list<VkPushConstantRange> psRanges)
 {
-    VkPipelineLayout layout;
-    VkPipelineLayoutCreateInfo layoutInfo{};
-    layoutInfo.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    layoutInfo.pNext                  = nullptr;
-    layoutInfo.pSetLayouts            = std::data(dsLayouts);
-    layoutInfo.setLayoutCount         = dsLayouts.size();
-    layoutInfo.pPushConstantRanges    = std::data(psRanges);
-    layoutInfo.pushConstantRangeCount = psRanges.size();
-    VK_CHECK(vkCreatePipelineLayout(spock::ctx.device, &layoutInfo, nullptr, &layout));
-    return layout;
-}
-union DescriptorWriteInfo {
-    VkDescriptorBufferInfo bufInfo;
-    VkDescriptorImageInfo  imgInfo;
-};
-void spock::update_descriptor_sets(std::initializer_list<ImageWrite> imageWrites, std::initializer_list<BufferWrite> bufferWrites) {
-    VkWriteDescriptorSet writeSets[32]; //max 32 writes for now
-    DescriptorWriteInfo  writeInfos[32];
-
-    int                  i = 0;
+    return cached_pipeline_layout(std::data(dsLayouts), dsLayouts.size(), std::data(psRanges), psRanges.size());
+}
+void spock::update_descriptor_sets(std::initializer_list<ImageWrite> imageWrites, std::initializer_list<BufferWrite> bufferWrites,
+                                   std::initializer_list<TexelBufferWrite> texelBufferWrites) {
+    //reused between calls, so steady state updates don't allocate
+    thread_local DescriptorWriter writer;
+
+    //count > 1 writes the same descriptor to consecutive elements
     for (auto& w : imageWrites) {
-#ifdef DBG
-        assert(i < 32);
-#endif
-        writeInfos[i].imgInfo.sampler     = w.sampler;
-        writeInfos[i].imgInfo.imageView   = w.imageView;
-        writeInfos[i].imgInfo.imageLayout = w.imageLayout;
-
-        writeSets[i] = VkWriteDescriptorSet{
-            .sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .pNext            = nullptr,
-            .dstSet           = w.descriptorSet,
-            .dstBinding       = w.binding,
-            .dstArrayElement  = w.index,
-            .descriptorCount  = w.count,
-            .descriptorType   = w.descriptorType,
-            .pImageInfo       = &writeInfos[i].imgInfo,
-            .pBufferInfo      = nullptr,
-            .pTexelBufferView = nullptr //unused for now
-        };
-
-        i++;
+        for (uint32_t i = 0; i < w.count; i++) {
+            writer.write_image(w.descriptorSet, w.binding, w.descriptorType, w.sampler, w.imageView, w.imageLayout, w.index + i);
+        }
     }
     for (auto& w : bufferWrites) {
-#ifdef DBG
-        assert(i < 32);
-#endif
-        writeInfos[i].bufInfo.buffer = w.buffer;
-        writeInfos[i].bufInfo.range  = w.range;
-        writeInfos[i].bufInfo.offset = w.offset;
+        for (uint32_t i = 0; i < w.count; i++) {
+            writer.write_buffer(w.descriptorSet, w.binding, w.descriptorType, w.buffer, w.offset, w.range, w.index + i);
+        }
+    }
+    for (auto& w : texelBufferWrites) {
+        for (uint32_t i = 0; i < w.count; i++) {
+            writer.write_texel_buffer(w.descriptorSet, w.binding, w.descriptorType, w.view, w.index + i);
+        }
+    }
+    writer.update();
+}
+
+//DescriptorData array, bindings back to back
+static std::vector<VkDescriptorUpdateTemplateEntry> template_entries(std::initializer_list<Binding> bindings) {
+    std::vector<VkDescriptorUpdateTemplateEntry> entries;
+    size_t                                       offset = 0;
+    for (auto& b : bindings) {
+        entries.push_back({
+            .dstBinding      = b.binding,
+            .dstArrayElement = 0,
+            .descriptorCount = b.count,
+            .descriptorType  = b.type,
+            .offset          = offset,
+            .stride          = sizeof(DescriptorData),
+        });
+        offset += b.count * sizeof(DescriptorData);
+    }
+    return entries;
+}
+
+VkDescriptorUpdateTemplate spock::create_descriptor_update_template(VkDescriptorSetLayout layout, std::initializer_list<Binding> bindings) {
+    std::vector<VkDescriptorUpdateTemplateEntry> entries = template_entries(bindings);
 
-        writeSets[i] = VkWriteDescriptorSet{
-            .sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .pNext            = nullptr,
-            .dstSet           = w.descriptorSet,
-            .dstBinding       = w.binding,
-            .dstArrayElement  = w.index,
-            .descriptorCount  = w.count,
-            .descriptorType   = w.descriptorType,
-            .pImageInfo       = nullptr,
-            .pBufferInfo      = &writeInfos[i].bufInfo,
-            .pTexelBufferView = nullptr //unused for now
-        };
+    VkDescriptorUpdateTemplateCreateInfo info = {.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO};
+    info.descriptorUpdateEntryCount           = entries.size();
+    info.pDescriptorUpdateEntries             = entries.data();
+    info.templateType                         = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+    info.descriptorSetLayout                  = layout;
+
+    VkDescriptorUpdateTemplate updateTemplate;
+    VK_CHECK(vkCreateDescriptorUpdateTemplate(ctx.device, &info, nullptr, &updateTemplate));
+    QUEUE_DESTROY_OBJ(updateTemplate);
+    return updateTemplate;
+}
+
+void spock::update_descriptor_set(VkDescriptorSet set, VkDescriptorUpdateTemplate updateTemplate, const DescriptorData* data) {
+    vkUpdateDescriptorSetWithTemplate(ctx.device, set, updateTemplate, data);
+}
 
-        i++;
+void spock::push_descriptor_set(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t set,
+                                std::initializer_list<ImageWrite> imageWrites, std::initializer_list<BufferWrite> bufferWrites) {
+    thread_local DescriptorWriter writer;
+    for (auto& w : imageWrites) {
+        for (uint32_t i = 0; i < w.count; i++) {
+            writer.write_image(VK_NULL_HANDLE, w.binding, w.descriptorType, w.sampler, w.imageView, w.imageLayout, w.index + i);
+        }
+    }
+    for (auto& w : bufferWrites) {
+        for (uint32_t i = 0; i < w.count; i++) {
+            writer.write_buffer(VK_NULL_HANDLE, w.binding, w.descriptorType, w.buffer, w.offset, w.range, w.index + i);
+        }
     }
-    vkUpdateDescriptorSets(ctx.device, i, writeSets, 0, nullptr);
+    writer.push(cmd, bindPoint, layout, set);
+}
+
+VkDescriptorUpdateTemplate spock::create_push_descriptor_template(VkDescriptorSetLayout setLayout, std::initializer_list<Binding> bindings,
+                                                                  VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t set) {
+    std::vector<VkDescriptorUpdateTemplateEntry> entries = template_entries(bindings);
+
+    VkDescriptorUpdateTemplateCreateInfo info = {.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO};
+    info.descriptorUpdateEntryCount           = entries.size();
+    info.pDescriptorUpdateEntries             = entries.data();
+    info.templateType                         = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR;
+    info.descriptorSetLayout                  = setLayout;
+    info.pipelineBindPoint                    = bindPoint;
+    info.pipelineLayout                       = layout;
+    info.set                                  = set;
+
+    VkDescriptorUpdateTemplate updateTemplate;
+    VK_CHECK(vkCreateDescriptorUpdateTemplate(ctx.device, &info, nullptr, &updateTemplate));
+    QUEUE_DESTROY_OBJ(updateTemplate);
+    return updateTemplate;
+}
+
+void spock::push_descriptor_set(VkCommandBuffer cmd, VkDescriptorUpdateTemplate updateTemplate, VkPipelineLayout layout, uint32_t set,
+                                const DescriptorData* data) {
+    assert(ctx.pushDescriptors);
+    ctx.pfnCmdPushDescriptorSetWithTemplate(cmd, updateTemplate, layout, set, data);
+}
+
+VkCommandBuffer spock::get_immediate_command_buffer() {
+    return ctx.immCommandBuffer;
 }
 
 void spock::begin_immediate_command() {
-    VK_CHECK(vkResetFences(ctx.device, 1, &ctx.immCommandFence));
-    VK_CHECK(vkResetCommandBuffer(ctx.immCommandBuffer, 0));
+    //takes a command buffer whose previous submission has finished, never waits on the gpu
+    ctx.immCommandBuffer = ctx.immCommands.acquire();
     VkCommandBufferBeginInfo cmdBeginInfo = info::begin::command_buffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
     VK_CHECK(vkBeginCommandBuffer(ctx.immCommandBuffer, &cmdBeginInfo));
 }
 
-void spock::end_immediate_command() {
+Ticket spock::end_immediate_command_async() {
     VK_CHECK(vkEndCommandBuffer(ctx.immCommandBuffer));
-    VkCommandBufferSubmitInfo cmdinfo = info::submit::command_buffer(ctx.immCommandBuffer);
-    VkSubmitInfo2             submit  = info::submit::submit(&cmdinfo, nullptr, nullptr);
-    // submit command buffer to the queue and execute it.
-    //  _renderFence will now block until the graphic commands finish execution
-    VK_CHECK(vkQueueSubmit2(ctx.graphicsQueue, 1, &submit, ctx.immCommandFence));
-    VK_CHECK(vkWaitForFences(ctx.device, 1, &ctx.immCommandFence, true, 9999999999));
+    uint64_t value = submit(ctx.graphicsQueue, ctx.timeline, ctx.immCommandBuffer);
+    ctx.immCommands.release(ctx.immCommandBuffer, value);
+    ctx.immCommandBuffer = VK_NULL_HANDLE;
+    return {&ctx.timeline, value};
+}
+
+void spock::end_immediate_command() {
+    SPOCK_TRACE_SCOPE("end_immediate_command");
+    // submit command buffer to the queue and block until the timeline reaches its value
+    end_immediate_command_async().wait();
 }
 
-Buffer spock::create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage) {
+//with a dedicated transfer family, buffers are shared between it and graphics so uploads into buffers
+//graphics already uses need no queue family ownership transfer. families must outlive the create call
+static void set_buffer_sharing(VkBufferCreateInfo& bufferInfo, uint32_t (&families)[2]) {
+    if (!ctx.dedicatedTransfer)
+        return;
+    families[0]                      = ctx.graphicsQueueFamily;
+    families[1]                      = ctx.transferQueueFamily;
+    bufferInfo.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount = 2;
+    bufferInfo.pQueueFamilyIndices   = families;
+}
+
+Buffer spock::create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, MemoryTag tag) {
     // allocate buffer
     VkBufferCreateInfo bufferInfo = {};
     bufferInfo.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.pNext              = nullptr;
     bufferInfo.size               = allocSize;
     bufferInfo.usage              = usage;
+    uint32_t families[2];
+    set_buffer_sharing(bufferInfo, families);
 
     VmaAllocationCreateInfo vmaallocInfo = {};
     vmaallocInfo.usage                   = memoryUsage;
-    vmaallocInfo.flags                   = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    //gpu only memory can't be mapped
+    vmaallocInfo.flags                   = memoryUsage == VMA_MEMORY_USAGE_GPU_ONLY ? 0 : VMA_ALLOCATION_CREATE_MAPPED_BIT;
     Buffer buffer;
     VK_CHECK(vmaCreateBuffer(ctx.allocator, &bufferInfo, &vmaallocInfo, &buffer.buffer, &buffer.allocation, &buffer.info));
+    track_allocation(buffer.allocation, tag);
     return buffer;
 }
 
-void spock::copy_to_buffer(VkBuffer buffer, void* src, VkDeviceSize srcOffset, VkDeviceSize dstOffset, VkDeviceSize size) {
-
-    Buffer uploadbuffer = create_buffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
-    void* data = uploadbuffer.info.pMappedData;
-    memcpy(uploadbuffer.info.pMappedData, src, size);
-    begin_immediate_command();
-
-    VkBufferCopy bufferCopy;
-    bufferCopy.srcOffset = srcOffset;
-    bufferCopy.dstOffset = dstOffset;
-    bufferCopy.size = size;
+Buffer spock::create_buffer(size_t allocSize, VkBufferUsageFlags usage, MemoryIntent intent, MemoryTag tag) {
+    VmaAllocationCreateInfo vmaallocInfo = {};
+    switch (intent) {
+        case MemoryIntent::DeviceOnly:
+            vmaallocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+            break;
+        case MemoryIntent::Upload:
+            vmaallocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+            vmaallocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+            break;
+        case MemoryIntent::Readback:
+            vmaallocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+            vmaallocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+            break;
+        case MemoryIntent::DeviceHostVisible:
+            //without rebar/uma the only mappable vram is the small bar window, keep it for the driver
+            //and use plain device memory filled through staging
+            if (!ctx.deviceLocalHostVisible) {
+                vmaallocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+                usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+                break;
+            }
+            //vma falls back to non-mappable device memory, which then has to be filled through staging
+            vmaallocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+            vmaallocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT |
+                                 VMA_ALLOCATION_CREATE_MAPPED_BIT;
+            usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            break;
+    }
 
-    vkCmdCopyBuffer(ctx.immCommandBuffer, uploadbuffer.buffer, buffer, 1, &bufferCopy);
-    end_immediate_command();
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size               = allocSize;
+    bufferInfo.usage              = usage;
+    uint32_t families[2];
+    set_buffer_sharing(bufferInfo, families);
 
-    vmaDestroyBuffer(ctx.allocator, uploadbuffer.buffer, uploadbuffer.allocation);
+    Buffer buffer;
+    VK_CHECK(vmaCreateBuffer(ctx.allocator, &bufferInfo, &vmaallocInfo, &buffer.buffer, &buffer.allocation, &buffer.info));
+    track_allocation(buffer.allocation, tag);
+    return buffer;
 }
 
-Image spock::create_image(void* data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped) {
-    size_t data_size    = size.depth * size.width * size.height * 4;
-    Buffer uploadbuffer = create_buffer(data_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+Ticket spock::copy_to_buffer(const Buffer& buffer, void* src, VkDeviceSize srcOffset, VkDeviceSize dstOffset, VkDeviceSize size) {
+    if (buffer.info.pMappedData == nullptr)
+        return copy_to_buffer(buffer.buffer, src, srcOffset, dstOffset, size);
 
-    memcpy(uploadbuffer.info.pMappedData, data, data_size);
-
-    Image new_image = create_image(size, format, usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, viewType, mipmapped);
-
-    begin_immediate_command();
-    image_barrier(ctx.immCommandBuffer, new_image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-    VkBufferImageCopy copyRegion = {};
-    copyRegion.bufferOffset      = 0;
-    copyRegion.bufferRowLength   = 0;
-    copyRegion.bufferImageHeight = 0;
+    //host visible, no staging copy or submission needed
+    memcpy((char*)buffer.info.pMappedData + dstOffset, (char*)src + srcOffset, size);
+    VK_CHECK(vmaFlushAllocation(ctx.allocator, buffer.allocation, dstOffset, size));
+    return {&ctx.timeline, 0};
+}
 
-    copyRegion.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
-    copyRegion.imageSubresource.mipLevel       = 0;
-    copyRegion.imageSubresource.baseArrayLayer = 0;
-    copyRegion.imageSubresource.layerCount     = 1;
-    copyRegion.imageExtent                     = size;
+Ticket spock::copy_to_buffer(VkBuffer buffer, void* src, VkDeviceSize srcOffset, VkDeviceSize dstOffset, VkDeviceSize size) {
+    //joins the open upload batch, otherwise submits a batch of one
+    if (upload_batch_open()) {
+        upload_buffer(buffer, (char*)src + srcOffset, dstOffset, size);
+        //not submitted yet, only end_upload_batch's ticket tracks it
+        return {};
+    }
 
-    // copy the buffer into the image
-    vkCmdCopyBufferToImage(ctx.immCommandBuffer, uploadbuffer.buffer, new_image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+    begin_upload_batch();
+    upload_buffer(buffer, (char*)src + srcOffset, dstOffset, size);
+    return end_upload_batch();
+}
 
-    image_barrier(ctx.immCommandBuffer, new_image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    end_immediate_command();
+Image spock::create_image(void* data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped, MemoryTag tag) {
+    SPOCK_TRACE_SCOPE("create_image(data)");
+    size_t data_size = size.depth * size.width * size.height * 4;
+    Image  new_image = create_image(size, format, usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, viewType, mipmapped, tag);
 
-    vmaDestroyBuffer(ctx.allocator, uploadbuffer.buffer, uploadbuffer.allocation);
+    bool   batched   = upload_batch_open();
+    if (!batched)
+        begin_upload_batch();
+    upload_image(new_image, data, data_size);
+    if (!batched)
+        end_upload_batch();
 
     return new_image;
 }
 
-Image spock::create_image(const char* fileName, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped)
+Image spock::create_image(const char* fileName, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped, MemoryTag tag)
 {
+    SPOCK_TRACE_SCOPE("create_image(file)");
     VkExtent3D     extent{};
     int            width = 0, height = 0;
     unsigned char* pixels = nullptr;
@@ -390,7 +808,7 @@ Image spock::create_image(const char* fileName, VkImageUsageFlags usage, VkImage
         extent.depth          = 1;
     }
 
-    auto image = create_image(pixels, extent, VK_FORMAT_R8G8B8A8_UNORM, usage, viewType, mipmapped);
+    auto image = create_image(pixels, extent, VK_FORMAT_R8G8B8A8_UNORM, usage, viewType, mipmapped, tag);
     if (empty) free(pixels);
     else stbi_image_free(pixels);
     return image;
@@ -405,6 +823,15 @@ Image spock::create_texture(const char* fileName, uint32_t index, VkDescriptorSe
     destroyQueue.push(image.imageView);
     return image;
 }
+Image spock::create_bindless_texture(const char* fileName, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped) {
+    auto image  = create_image(fileName, usage | VK_IMAGE_USAGE_SAMPLED_BIT, viewType, mipmapped);
+    image.index = register_sampled_image(image.imageView);
+
+    destroyQueue.push(image);
+    destroyQueue.push(image.imageView);
+    return image;
+}
+
 void spock::create_texture(Image& image, uint32_t index, VkDescriptorSet descriptorSet, uint32_t binding, VkSampler sampler)
 {
     if (image.image == VK_NULL_HANDLE || image.imageView == VK_NULL_HANDLE) {
@@ -415,7 +842,8 @@ void spock::create_texture(Image& image, uint32_t index, VkDescriptorSet descrip
         {{descriptorSet, binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sampler, image.imageView, VK_IMAGE_LAYOUT_GENERAL, index}}, {});
 }
 
-Image spock::create_image(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped) {
+Image spock::create_image(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped, MemoryTag tag) {
+    SPOCK_TRACE_SCOPE("create_image");
     Image newImage;
     newImage.imageFormat = format;
 
@@ -506,6 +934,7 @@ Image spock::create_image(VkExtent3D size, VkFormat format, VkImageUsageFlags us
     allocinfo.requiredFlags           = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
     VK_CHECK(vmaCreateImage(ctx.allocator, &img_info, &allocinfo, &newImage.image, &newImage.allocation, nullptr));
+    track_allocation(newImage.allocation, tag);
 
     // build a image-view for the image
     VkImageViewCreateInfo view_info       = info::create::image_view(format, newImage.image, viewType, subresourceRange);
@@ -517,23 +946,43 @@ Image spock::create_image(VkExtent3D size, VkFormat format, VkImageUsageFlags us
 
 void spock::destroy_image(Image image)
 {
+    untrack_allocation(image.allocation);
     vmaDestroyImage(spock::ctx.allocator, image.image, image.allocation);
     vkDestroyImageView(spock::ctx.device, image.imageView, nullptr);
 }
+
+//first supported mode in the fallback chain of the requested one, FIFO is always supported
+static VkPresentModeKHR choose_present_mode(VkPresentModeKHR desired) {
+    uint32_t count = 0;
+    VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(ctx.physicalDevice, ctx.surface, &count, nullptr));
+    std::vector<VkPresentModeKHR> supported(count);
+    VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(ctx.physicalDevice, ctx.surface, &count, supported.data()));
+
+    //never swap tearing for non-tearing or the other way round, FIFO is the only fallback (always supported)
+    if (std::find(supported.begin(), supported.end(), desired) != supported.end())
+        return desired;
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
 void spock::create_swapchain(uint32_t width, uint32_t height) {
     vkb::SwapchainBuilder swapchainBuilder{ctx.physicalDevice, ctx.device, ctx.surface};
     ctx.swapchain.imageFormat   = VK_FORMAT_B8G8R8A8_UNORM;
-    vkb::Swapchain vkbSwapchain = swapchainBuilder
-                                      //.use_default_format_selection()
-                                      .set_desired_format(VkSurfaceFormatKHR{.format = ctx.swapchain.imageFormat, .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR})
-                                      //use vsync present mode
-                                      .set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
-                                      .set_desired_extent(width, height)
-                                      .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
-                                      .add_image_usage_flags(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
-                                      .build()
-                                      .value();
-
+    ctx.swapchain.presentMode   = choose_present_mode(ctx.presentMode);
+    swapchainBuilder
+        //lets the driver reuse resources, the caller destroys the old swapchain
+        .set_old_swapchain(ctx.swapchain.swapchain)
+        //.use_default_format_selection()
+        .set_desired_format(VkSurfaceFormatKHR{.format = ctx.swapchain.imageFormat, .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR})
+        .set_desired_present_mode(ctx.swapchain.presentMode)
+        .set_desired_extent(width, height)
+        .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+        .add_image_usage_flags(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+    if (ctx.minImageCount > 0)
+        swapchainBuilder.set_desired_min_image_count(ctx.minImageCount);
+    vkb::Swapchain vkbSwapchain = swapchainBuilder.build().value();
+
+    //present ids restart with every swapchain
+    ctx.swapchainFirstPresentId = ctx.presentId + 1;
     ctx.swapchain.extent = vkbSwapchain.extent;
     //store swapchain and its related images
     ctx.swapchain.swapchain  = vkbSwapchain.swapchain;
@@ -545,32 +994,57 @@ void spock::cleanup() {
     if (!ctx.initialised)
         return;
 
+    destroy_pipeline_workers();
     vkDeviceWaitIdle(ctx.device);
-    for (int i = 0; i < FRAME_OVERLAP; i++) {
-        vkDestroyCommandPool(ctx.device, ctx.frames[i].commandPool, nullptr);
+    destroy_queries();
+    for (auto& frame : ctx.frames) {
+        vkDestroyCommandPool(ctx.device, frame.commandPool, nullptr);
+        vkDestroyCommandPool(ctx.device, frame.computeCommandPool, nullptr);
+        for (auto& t : frame.threadCommands) {
+            vkDestroyCommandPool(ctx.device, t.pool, nullptr);
+        }
 
         //destroy sync objects
-        vkDestroyFence(ctx.device, ctx.frames[i].renderFence, nullptr);
-        vkDestroySemaphore(ctx.device, ctx.frames[i].renderSemaphore, nullptr);
-        vkDestroySemaphore(ctx.device, ctx.frames[i].swapchainSemaphore, nullptr);
+        vkDestroySemaphore(ctx.device, frame.renderSemaphore, nullptr);
+        vkDestroySemaphore(ctx.device, frame.swapchainSemaphore, nullptr);
 
-        ctx.frames[i].descriptorAllocator.destroy_pools();
-        ctx.frames[i].destroyQueue.flush();
+        frame.descriptorAllocator.destroy_pools();
+        frame.linearAllocator.destroy();
+        frame.destroyQueue.flush();
     }
-
+    ctx.frames.clear();
+
+    ctx.immCommands.destroy();
+    if (ctx.dedicatedTransfer)
+        ctx.transferCommands.destroy();
+    destroy_staging_ring();
+    destroy_gpu_profiler();
+    destroy_bindless();
     destroyQueue.flush();
-
-    destroy_swapchain();
-
-    vkDestroySurfaceKHR(ctx.instance, ctx.surface, nullptr);
+    destroy_layout_caches();
+    destroy_pipeline_cache();
+    ctx.offscreenImages.clear();
+    ctx.timeline.destroy();
+    if (ctx.dedicatedTransfer)
+        ctx.transferTimeline.destroy();
+    if (ctx.asyncCompute)
+        ctx.computeTimeline.destroy();
+
+    if (!ctx.headless) {
+        destroy_swapchain();
+        vkDestroySurfaceKHR(ctx.instance, ctx.surface, nullptr);
+    }
     vkDestroyDevice(ctx.device, nullptr);
 
     vkb::destroy_debug_utils_messenger(ctx.instance, ctx.debugMessenger);
     vkDestroyInstance(ctx.instance, nullptr);
-    glfwDestroyWindow(ctx.window);
-    glfwTerminate();
+    if (!ctx.headless) {
+        glfwDestroyWindow(ctx.window);
+        glfwTerminate();
+    }
 }
 
 void spock::destroy_buffer(Buffer buffer) {
+    untrack_allocation(buffer.allocation);
     vmaDestroyBuffer(ctx.allocator, buffer.buffer, buffer.allocation);
 }
@@ -1,45 +1,78 @@
+#include <algorithm>
+#include <cstdio>
 #include "spock/descriptor.hpp"
 #include "spock/internal.hpp"
 #include "spock/util.hpp"
+#include "spock/trace.hpp"
 
 using namespace spock;
 
-void DescriptorAllocator::init(VkDescriptorType t, uint32_t sz) {
-    type = t;
-    startSize = sz;
-    setsPerPool = 1; //grow it next allocation
-    pools.push_back(create_pool());
-    initialised = true;
+void DescriptorAllocator::init(uint32_t initialSets, std::initializer_list<PoolRatio> poolRatios, uint32_t maxSets) {
+    ratios         = poolRatios;
+    maxSetsPerPool = std::max(maxSets, 1u);
+    setsPerPool    = std::clamp(initialSets, 1u, maxSetsPerPool);
+    readyPools.push_back(create_pool(setsPerPool));
+    //grow it next allocation
+    setsPerPool    = std::min(setsPerPool * 2, maxSetsPerPool);
+    initialised    = true;
 }
 
-VkDescriptorPool DescriptorAllocator::create_pool() {
-    VkDescriptorPoolSize sz = {.type = type, .descriptorCount = uint32_t(startSize * setsPerPool)};
+void DescriptorAllocator::init(VkDescriptorType type, uint32_t startSize) {
+    init(64, {{type, float(startSize)}});
+}
+
+VkDescriptorPool DescriptorAllocator::create_pool(uint32_t setCount) {
+    std::vector<VkDescriptorPoolSize> sizes;
+    for (auto& r : ratios) {
+        sizes.push_back({.type = r.type, .descriptorCount = std::max(uint32_t(r.ratio * setCount), 1u)});
+    }
 
     VkDescriptorPoolCreateInfo pool_info = {};
     pool_info.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     pool_info.flags                      = flags;
-    pool_info.maxSets                    = 64;
-    pool_info.poolSizeCount              = 1;
-    pool_info.pPoolSizes                 = &sz;
+    pool_info.maxSets                    = setCount;
+    pool_info.poolSizeCount              = sizes.size();
+    pool_info.pPoolSizes                 = sizes.data();
 
     VkDescriptorPool pool;
-    VkResult r = vkCreateDescriptorPool(ctx.device, &pool_info, nullptr, &pool);
-    assert(r == VK_SUCCESS);
+    VK_CHECK(vkCreateDescriptorPool(ctx.device, &pool_info, nullptr, &pool));
+    return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::get_pool(bool& created) {
+    created = readyPools.empty();
+    if (!created) {
+        VkDescriptorPool pool = readyPools.back();
+        readyPools.pop_back();
+        return pool;
+    }
+    VkDescriptorPool pool = create_pool(setsPerPool);
+    setsPerPool           = std::min(setsPerPool * 2, maxSetsPerPool);
     return pool;
 }
 
 void DescriptorAllocator::clear_pools() {
-    for (auto p : pools) {
+    for (auto p : usedPools) {
+        vkResetDescriptorPool(ctx.device, p, 0);
+    }
+    for (auto p : fullPools) {
         vkResetDescriptorPool(ctx.device, p, 0);
+        readyPools.push_back(p);
     }
-    currentPool = 0;
+    usedPools.clear();
+    fullPools.clear();
 }
 
 void DescriptorAllocator::destroy_pools() {
-    for (auto p : pools) {
+    for (auto p : readyPools) {
         vkDestroyDescriptorPool(ctx.device, p, nullptr);
     }
-    currentPool = 0;
+    for (auto p : fullPools) {
+        vkDestroyDescriptorPool(ctx.device, p, nullptr);
+    }
+    readyPools.clear();
+    fullPools.clear();
+    usedPools.clear();
 }
 
 void DescriptorAllocator::set_flags(VkDescriptorPoolCreateFlags _flags) {
@@ -47,25 +80,133 @@ void DescriptorAllocator::set_flags(VkDescriptorPoolCreateFlags _flags) {
 }
 
 VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+    SPOCK_TRACE_SCOPE("DescriptorAllocator::allocate");
     assert(initialised);
+    bool                        created;
+    VkDescriptorPool            pool      = get_pool(created);
     VkDescriptorSetAllocateInfo allocInfo = {};
     allocInfo.pNext                       = VK_NULL_HANDLE;
     allocInfo.sType                       = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool              = pools[currentPool];
+    allocInfo.descriptorPool              = pool;
     allocInfo.descriptorSetCount          = 1;
     allocInfo.pSetLayouts                 = &layout;
 
     VkDescriptorSet ds;
     VkResult        result = vkAllocateDescriptorSets(ctx.device, &allocInfo, &ds);
 
-    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
-        currentPool++;
-        if (currentPool == pools.size()) {
-            pools.push_back(create_pool());
-            setsPerPool *= 2;
+    //move on through the ready pools, then to a new one
+    while (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+        //only the pool being allocated from can be partly used, it's always the last one in usedPools
+        if (!usedPools.empty() && usedPools.back() == pool)
+            usedPools.pop_back();
+        fullPools.push_back(pool);
+        //an empty pool can't fit it either: the layout needs more of a type than ratio * sets, or a type not in ratios
+        if (created) {
+            printf("Descriptor set layout doesn't fit a new descriptor pool, check the allocator's ratios\n");
+            abort();
         }
-        allocInfo.descriptorPool = pools[currentPool];
-        VK_CHECK(vkAllocateDescriptorSets(ctx.device, &allocInfo, &ds));
+        pool                     = get_pool(created);
+        allocInfo.descriptorPool = pool;
+        result                   = vkAllocateDescriptorSets(ctx.device, &allocInfo, &ds);
+    }
+    if (result != VK_SUCCESS) {
+        printf("Failed to allocate descriptor set: %d\n", result);
+        abort();
     }
+    if (usedPools.empty() || usedPools.back() != pool)
+        usedPools.push_back(pool);
+    readyPools.push_back(pool);
     return ds;
 }
+
+static bool is_image_type(VkDescriptorType type) {
+    return type == VK_DESCRIPTOR_TYPE_SAMPLER || type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER || type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+           type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE || type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+}
+
+static bool is_texel_buffer_type(VkDescriptorType type) {
+    return type == VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER || type == VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+}
+
+bool DescriptorWriter::append(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, uint32_t arrayElement, uint32_t infoOffset) {
+    if (!writes.empty()) {
+        VkWriteDescriptorSet& last = writes.back();
+        //the previous write's infos end right where this one's starts, as long as they are the same type
+        if (last.dstSet == set && last.dstBinding == binding && last.descriptorType == type &&
+            last.dstArrayElement + last.descriptorCount == arrayElement && infoOffsets.back() + last.descriptorCount == infoOffset) {
+            last.descriptorCount++;
+            return true;
+        }
+    }
+
+    writes.push_back({
+        .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet          = set,
+        .dstBinding      = binding,
+        .dstArrayElement = arrayElement,
+        .descriptorCount = 1,
+        .descriptorType  = type,
+    });
+    infoOffsets.push_back(infoOffset);
+    return false;
+}
+
+DescriptorWriter& DescriptorWriter::write_image(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkSampler sampler, VkImageView view,
+                                                VkImageLayout layout, uint32_t arrayElement) {
+    append(set, binding, type, arrayElement, imageInfos.size());
+    imageInfos.push_back({.sampler = sampler, .imageView = view, .imageLayout = layout});
+    return *this;
+}
+
+DescriptorWriter& DescriptorWriter::write_buffer(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset,
+                                                 VkDeviceSize range, uint32_t arrayElement) {
+    append(set, binding, type, arrayElement, bufferInfos.size());
+    bufferInfos.push_back({.buffer = buffer, .offset = offset, .range = range});
+    return *this;
+}
+
+DescriptorWriter& DescriptorWriter::write_texel_buffer(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkBufferView view,
+                                                       uint32_t arrayElement) {
+    append(set, binding, type, arrayElement, texelBufferViews.size());
+    texelBufferViews.push_back(view);
+    return *this;
+}
+
+//the info arrays may have reallocated while recording, pointers are only resolved before use
+static void resolve_infos(DescriptorWriter& w) {
+    auto& writes = w.writes;
+    for (size_t i = 0; i < writes.size(); i++) {
+        VkDescriptorType type = writes[i].descriptorType;
+        if (is_image_type(type))
+            writes[i].pImageInfo = w.imageInfos.data() + w.infoOffsets[i];
+        else if (is_texel_buffer_type(type))
+            writes[i].pTexelBufferView = w.texelBufferViews.data() + w.infoOffsets[i];
+        else
+            writes[i].pBufferInfo = w.bufferInfos.data() + w.infoOffsets[i];
+    }
+}
+
+void DescriptorWriter::update() {
+    if (writes.empty())
+        return;
+    resolve_infos(*this);
+    vkUpdateDescriptorSets(ctx.device, writes.size(), writes.data(), 0, nullptr);
+    clear();
+}
+
+void DescriptorWriter::push(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t set) {
+    assert(ctx.pushDescriptors);
+    if (writes.empty())
+        return;
+    resolve_infos(*this);
+    ctx.pfnCmdPushDescriptorSet(cmd, bindPoint, layout, set, writes.size(), writes.data());
+    clear();
+}
+
+void DescriptorWriter::clear() {
+    writes.clear();
+    infoOffsets.clear();
+    imageInfos.clear();
+    bufferInfos.clear();
+    texelBufferViews.clear();
+}
@@ -0,0 +1,161 @@
+#include <cstring>
+#include "spock/descriptor_buffer.hpp"
+#include "spock/core.hpp"
+#include "spock/internal.hpp"
+#include "spock/layout_cache.hpp"
+#include "spock/util.hpp"
+
+using namespace spock;
+
+static struct DescriptorBufferContext {
+    VkPhysicalDeviceDescriptorBufferPropertiesEXT props = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT};
+
+    PFN_vkGetDescriptorSetLayoutSizeEXT          getLayoutSize;
+    PFN_vkGetDescriptorSetLayoutBindingOffsetEXT getBindingOffset;
+    PFN_vkGetDescriptorEXT                       getDescriptor;
+    PFN_vkCmdBindDescriptorBuffersEXT            cmdBindBuffers;
+    PFN_vkCmdSetDescriptorBufferOffsetsEXT       cmdSetOffsets;
+} db;
+
+static VkDeviceSize align_up(VkDeviceSize v, VkDeviceSize alignment) {
+    return (v + alignment - 1) / alignment * alignment;
+}
+
+static size_t descriptor_size(VkDescriptorType type) {
+    switch (type) {
+        case VK_DESCRIPTOR_TYPE_SAMPLER: return db.props.samplerDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER: return db.props.combinedImageSamplerDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE: return db.props.sampledImageDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE: return db.props.storageImageDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER: return db.props.uniformTexelBufferDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER: return db.props.storageTexelBufferDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER: return db.props.uniformBufferDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER: return db.props.storageBufferDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT: return db.props.inputAttachmentDescriptorSize;
+        default: assert(false); return 0;
+    }
+}
+
+void spock::init_descriptor_buffers() {
+    if (!ctx.descriptorBuffer)
+        return;
+    VkPhysicalDeviceProperties2 props{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &db.props};
+    vkGetPhysicalDeviceProperties2(ctx.physicalDevice, &props);
+
+    db.getLayoutSize    = (PFN_vkGetDescriptorSetLayoutSizeEXT)vkGetDeviceProcAddr(ctx.device, "vkGetDescriptorSetLayoutSizeEXT");
+    db.getBindingOffset = (PFN_vkGetDescriptorSetLayoutBindingOffsetEXT)vkGetDeviceProcAddr(ctx.device, "vkGetDescriptorSetLayoutBindingOffsetEXT");
+    db.getDescriptor    = (PFN_vkGetDescriptorEXT)vkGetDeviceProcAddr(ctx.device, "vkGetDescriptorEXT");
+    db.cmdBindBuffers   = (PFN_vkCmdBindDescriptorBuffersEXT)vkGetDeviceProcAddr(ctx.device, "vkCmdBindDescriptorBuffersEXT");
+    db.cmdSetOffsets    = (PFN_vkCmdSetDescriptorBufferOffsetsEXT)vkGetDeviceProcAddr(ctx.device, "vkCmdSetDescriptorBufferOffsetsEXT");
+}
+
+void DescriptorBuffer::init(VkDeviceSize size, bool samplers) {
+    assert(ctx.descriptorBuffer);
+    usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    if (samplers)
+        usage |= VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT;
+    //written by the cpu, read by the gpu. device local on ReBAR/UMA
+    buffer = create_buffer(size, usage, MemoryIntent::Upload);
+    VkBufferDeviceAddressInfo addressInfo{.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = buffer.buffer};
+    address = vkGetBufferDeviceAddress(ctx.device, &addressInfo);
+    head    = 0;
+}
+
+void DescriptorBuffer::destroy() {
+    destroy_buffer(buffer);
+    buffer  = {};
+    address = 0;
+}
+
+VkDeviceSize DescriptorBuffer::allocate(VkDescriptorSetLayout layout) {
+    VkDeviceSize layoutSize;
+    db.getLayoutSize(ctx.device, layout, &layoutSize);
+    //head stays aligned, so a plain atomic add hands out aligned offsets
+    VkDeviceSize size   = align_up(layoutSize, db.props.descriptorBufferOffsetAlignment);
+    VkDeviceSize offset = head.fetch_add(size);
+    //out of descriptor memory, make the buffer bigger
+    assert(offset + size <= buffer.info.size);
+    return offset;
+}
+
+void DescriptorBuffer::reset() {
+    head = 0;
+}
+
+static VkDeviceSize binding_offset(VkDeviceSize setOffset, VkDescriptorSetLayout layout, uint32_t binding) {
+    VkDeviceSize bindingOffset;
+    db.getBindingOffset(ctx.device, layout, binding, &bindingOffset);
+    return setOffset + bindingOffset;
+}
+
+//upload memory may be non-coherent, flush every write so the gpu never reads stale descriptors. no-op when coherent
+static void write_bytes(const DescriptorBuffer& b, const void* data, size_t size, VkDeviceSize offset) {
+    memcpy((char*)b.buffer.info.pMappedData + offset, data, size);
+    VK_CHECK(vmaFlushAllocation(ctx.allocator, b.buffer.allocation, offset, size));
+}
+
+static void get_descriptor(const DescriptorBuffer& b, const VkDescriptorGetInfoEXT& info, VkDeviceSize offset) {
+    size_t size = descriptor_size(info.type);
+    db.getDescriptor(ctx.device, &info, size, (char*)b.buffer.info.pMappedData + offset);
+    VK_CHECK(vmaFlushAllocation(ctx.allocator, b.buffer.allocation, offset, size));
+}
+
+void DescriptorBuffer::write_image(VkDeviceSize setOffset, VkDescriptorSetLayout layout, uint32_t binding, VkDescriptorType type, VkSampler sampler,
+                                   VkImageView view, VkImageLayout imageLayout, uint32_t arrayElement) {
+    VkDescriptorImageInfo  imageInfo{.sampler = sampler, .imageView = view, .imageLayout = imageLayout};
+    VkDescriptorGetInfoEXT info{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT, .type = type};
+    switch (type) {
+        case VK_DESCRIPTOR_TYPE_SAMPLER: info.data.pSampler = &sampler; break;
+        case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER: info.data.pCombinedImageSampler = &imageInfo; break;
+        case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE: info.data.pSampledImage = &imageInfo; break;
+        case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE: info.data.pStorageImage = &imageInfo; break;
+        case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT: info.data.pInputAttachmentImage = &imageInfo; break;
+        default: assert(false); return;
+    }
+    VkDeviceSize offset = binding_offset(setOffset, layout, binding);
+    if (type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER && !db.props.combinedImageSamplerDescriptorSingleArray) {
+        //the binding is laid out as all the image halves followed by all the sampler halves.
+        //the descriptor comes back as image then sampler, split it into the two arrays
+        size_t imageSize   = db.props.sampledImageDescriptorSize;
+        size_t samplerSize = db.props.samplerDescriptorSize;
+        char   data[256];
+        assert(db.props.combinedImageSamplerDescriptorSize <= sizeof(data));
+        db.getDescriptor(ctx.device, &info, db.props.combinedImageSamplerDescriptorSize, data);
+        uint32_t count = cached_binding_count(layout, binding);
+        write_bytes(*this, data, imageSize, offset + arrayElement * imageSize);
+        write_bytes(*this, data + imageSize, samplerSize, offset + count * imageSize + arrayElement * samplerSize);
+        return;
+    }
+    get_descriptor(*this, info, offset + arrayElement * descriptor_size(type));
+}
+
+void DescriptorBuffer::write_buffer(VkDeviceSize setOffset, VkDescriptorSetLayout layout, uint32_t binding, VkDescriptorType type,
+                                    VkDeviceAddress bufferAddress, VkDeviceSize range, uint32_t arrayElement, VkFormat format) {
+    VkDescriptorAddressInfoEXT addressInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT, .address = bufferAddress, .range = range, .format = format};
+    VkDescriptorGetInfoEXT     info{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT, .type = type};
+    switch (type) {
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER: info.data.pUniformBuffer = &addressInfo; break;
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER: info.data.pStorageBuffer = &addressInfo; break;
+        case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER: info.data.pUniformTexelBuffer = &addressInfo; break;
+        case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER: info.data.pStorageTexelBuffer = &addressInfo; break;
+        default: assert(false); return;
+    }
+    get_descriptor(*this, info, binding_offset(setOffset, layout, binding) + arrayElement * descriptor_size(type));
+}
+
+void spock::bind_descriptor_buffers(VkCommandBuffer cmd, std::initializer_list<const DescriptorBuffer*> buffers) {
+    //max 4 buffers, devices support at most one sampler and a few resource buffers anyway
+    assert(buffers.size() <= 4);
+    VkDescriptorBufferBindingInfoEXT infos[4];
+    uint32_t                         count = 0;
+    for (auto b : buffers) {
+        infos[count++] = {.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT, .address = b->address, .usage = b->usage};
+    }
+    db.cmdBindBuffers(cmd, count, infos);
+}
+
+void spock::set_descriptor_buffer_offsets(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet,
+                                          std::initializer_list<uint32_t> bufferIndices, std::initializer_list<VkDeviceSize> offsets) {
+    assert(bufferIndices.size() == offsets.size());
+    db.cmdSetOffsets(cmd, bindPoint, layout, firstSet, bufferIndices.size(), std::data(bufferIndices), std::data(offsets));
+}
@@ -1,5 +1,7 @@
 #include "spock/destroy.hpp"
 #include "spock/internal.hpp"
+#include "spock/trace.hpp"
+#include "spock/memory.hpp"
 #include <cstdio>
 
 void spock::Object::destroy() {
@@ -8,7 +10,10 @@ void spock::Object::destroy() {
         printf("Destroying object at %s:%d\n", fileName, lineNumber);
 #endif
     switch (type) {
-        case OBJ::Image: vmaDestroyImage(ctx.allocator, image, allocation); break;
+        case OBJ::Image:
+            untrack_allocation(allocation);
+            vmaDestroyImage(ctx.allocator, image, allocation);
+            break;
         case OBJ::ImageView: vkDestroyImageView(ctx.device, imageView, nullptr); break;
         case OBJ::Allocator: vmaDestroyAllocator(ctx.allocator); break;
         case OBJ::DescriptorPool: vkDestroyDescriptorPool(ctx.device, dp, nullptr); break;
@@ -17,17 +22,47 @@ void spock::Object::destroy() {
         case OBJ::Pipeline: vkDestroyPipeline(ctx.device, pl, nullptr); break;
         case OBJ::Fence: vkDestroyFence(ctx.device, fence, nullptr); break;
         case OBJ::CommandPool: vkDestroyCommandPool(ctx.device, commandPool, nullptr); break;
-        case OBJ::Buffer: vmaDestroyBuffer(ctx.allocator, buffer, allocation); break;
+        case OBJ::Buffer:
+            untrack_allocation(allocation);
+            vmaDestroyBuffer(ctx.allocator, buffer, allocation);
+            break;
         case OBJ::Sampler: vkDestroySampler(ctx.device, sampler, nullptr); break;
+        case OBJ::Swapchain: vkDestroySwapchainKHR(ctx.device, swapchain, nullptr); break;
+        case OBJ::DescriptorUpdateTemplate: vkDestroyDescriptorUpdateTemplate(ctx.device, dut, nullptr); break;
         default: break;
     }
 }
 
 void spock::DestroyQueue::push(Object obj) {
+    std::lock_guard<std::mutex> lock(mutex);
     queue.push_back(obj);
 }
 
+void spock::DestroyQueue::push(Object obj, uint64_t timelineValue) {
+    std::lock_guard<std::mutex> lock(mutex);
+    deferred.push_back({timelineValue, obj});
+}
+
+void spock::DestroyQueue::collect(uint64_t completedValue) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t                      kept = 0;
+    for (size_t i = 0; i < deferred.size(); i++) {
+        if (deferred[i].first <= completedValue)
+            deferred[i].second.destroy();
+        else
+            deferred[kept++] = deferred[i];
+    }
+    deferred.resize(kept);
+}
+
 void spock::DestroyQueue::flush() {
+    SPOCK_TRACE_SCOPE("DestroyQueue::flush");
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = deferred.rbegin(); it != deferred.rend(); it++) {
+        it->second.destroy();
+    }
+    deferred.clear();
+
     for (auto it = queue.rbegin(); it != queue.rend(); it++) {
         it->destroy();
     }
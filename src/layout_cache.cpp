@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <mutex>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "spock/layout_cache.hpp"
+#include "spock/internal.hpp"
+#include "spock/util.hpp"
+
+using namespace spock;
+
+//layouts are flattened into a list of words, equal keys mean structurally identical layouts
+using LayoutKey = std::vector<uint64_t>;
+
+struct LayoutKeyHash {
+    size_t operator()(const LayoutKey& key) const {
+        //fnv-1a over the words
+        uint64_t h = 14695981039346656037ull;
+        for (uint64_t w : key) {
+            h = (h ^ w) * 1099511628211ull;
+        }
+        return h;
+    }
+};
+
+static struct LayoutCache {
+    std::mutex                                                          mutex;
+    std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutKeyHash> setLayouts;
+    std::unordered_map<LayoutKey, VkPipelineLayout, LayoutKeyHash>      pipelineLayouts;
+    std::unordered_set<VkDescriptorSetLayout>                           pushLayouts;
+    //binding -> descriptorCount, descriptor buffer writes need it to place split combined image samplers
+    std::unordered_map<VkDescriptorSetLayout, std::unordered_map<uint32_t, uint32_t>> descriptorBufferLayouts;
+    std::unordered_set<VkPipelineLayout>                                descriptorBufferPipelineLayouts;
+} cache;
+
+VkDescriptorSetLayout spock::cached_descriptor_set_layout(const VkDescriptorSetLayoutBinding* bindings, const VkDescriptorBindingFlags* bindingFlags,
+                                                          uint32_t bindingCount, VkDescriptorSetLayoutCreateFlags flags) {
+    //binding order doesn't matter to vulkan, key them sorted
+    std::vector<uint32_t> order(bindingCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return bindings[a].binding < bindings[b].binding; });
+
+    LayoutKey key;
+    key.reserve(1 + bindingCount * 6);
+    key.push_back(flags);
+    for (uint32_t i : order) {
+        const VkDescriptorSetLayoutBinding& b = bindings[i];
+        key.push_back(b.binding);
+        key.push_back(b.descriptorType);
+        key.push_back(b.descriptorCount);
+        key.push_back(b.stageFlags);
+        key.push_back(bindingFlags ? bindingFlags[i] : 0);
+        //immutable samplers are part of the layout, descriptorCount handles when present
+        key.push_back(b.pImmutableSamplers != nullptr);
+        for (uint32_t j = 0; b.pImmutableSamplers && j < b.descriptorCount; j++) {
+            key.push_back((uint64_t)b.pImmutableSamplers[j]);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto                        it = cache.setLayouts.find(key);
+    if (it != cache.setLayouts.end())
+        return it->second;
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+    flagsInfo.bindingCount                                = bindingCount;
+    flagsInfo.pBindingFlags                               = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo info = {.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    info.pNext                           = bindingFlags ? &flagsInfo : nullptr;
+    info.pBindings                       = bindings;
+    info.bindingCount                    = bindingCount;
+    info.flags                           = flags;
+
+    VkDescriptorSetLayout layout;
+    VK_CHECK(vkCreateDescriptorSetLayout(ctx.device, &info, nullptr, &layout));
+    cache.setLayouts.emplace(std::move(key), layout);
+    if (flags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR)
+        cache.pushLayouts.insert(layout);
+    if (flags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT) {
+        auto& counts = cache.descriptorBufferLayouts[layout];
+        for (uint32_t i = 0; i < bindingCount; i++) {
+            counts[bindings[i].binding] = bindings[i].descriptorCount;
+        }
+    }
+    return layout;
+}
+
+VkPipelineLayout spock::cached_pipeline_layout(const VkDescriptorSetLayout* setLayouts, uint32_t setLayoutCount, const VkPushConstantRange* ranges,
+                                               uint32_t rangeCount) {
+    //set layouts are cached too, so equal handles mean equal set layouts
+    LayoutKey key;
+    key.reserve(2 + setLayoutCount + rangeCount * 3);
+    key.push_back(setLayoutCount);
+    for (uint32_t i = 0; i < setLayoutCount; i++) {
+        key.push_back((uint64_t)setLayouts[i]);
+    }
+    key.push_back(rangeCount);
+    for (uint32_t i = 0; i < rangeCount; i++) {
+        key.push_back(ranges[i].stageFlags);
+        key.push_back(ranges[i].offset);
+        key.push_back(ranges[i].size);
+    }
+
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto                        it = cache.pipelineLayouts.find(key);
+    if (it != cache.pipelineLayouts.end())
+        return it->second;
+
+    //vulkan allows only one push descriptor set per pipeline layout
+    uint32_t pushSets = 0;
+    //and descriptor buffer set layouts can't be mixed with regular ones
+    uint32_t descriptorBufferSets = 0;
+    for (uint32_t i = 0; i < setLayoutCount; i++) {
+        pushSets += cache.pushLayouts.count(setLayouts[i]);
+        descriptorBufferSets += cache.descriptorBufferLayouts.count(setLayouts[i]);
+    }
+    assert(pushSets <= 1);
+    assert(descriptorBufferSets == 0 || descriptorBufferSets == setLayoutCount);
+
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext                  = nullptr;
+    layoutInfo.pSetLayouts            = setLayouts;
+    layoutInfo.setLayoutCount         = setLayoutCount;
+    layoutInfo.pPushConstantRanges    = ranges;
+    layoutInfo.pushConstantRangeCount = rangeCount;
+
+    VkPipelineLayout layout;
+    VK_CHECK(vkCreatePipelineLayout(ctx.device, &layoutInfo, nullptr, &layout));
+    cache.pipelineLayouts.emplace(std::move(key), layout);
+    if (descriptorBufferSets > 0)
+        cache.descriptorBufferPipelineLayouts.insert(layout);
+    return layout;
+}
+
+bool spock::uses_descriptor_buffer(VkPipelineLayout layout) {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    return cache.descriptorBufferPipelineLayouts.count(layout) > 0;
+}
+
+uint32_t spock::cached_binding_count(VkDescriptorSetLayout layout, uint32_t binding) {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto                        it = cache.descriptorBufferLayouts.find(layout);
+    //only descriptor buffer layouts made by the cache are tracked
+    assert(it != cache.descriptorBufferLayouts.end() && it->second.count(binding));
+    return it->second[binding];
+}
+
+void spock::destroy_layout_caches() {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    for (auto& [key, layout] : cache.pipelineLayouts) {
+        vkDestroyPipelineLayout(ctx.device, layout, nullptr);
+    }
+    for (auto& [key, layout] : cache.setLayouts) {
+        vkDestroyDescriptorSetLayout(ctx.device, layout, nullptr);
+    }
+    cache.pipelineLayouts.clear();
+    cache.setLayouts.clear();
+    cache.pushLayouts.clear();
+    cache.descriptorBufferLayouts.clear();
+    cache.descriptorBufferPipelineLayouts.clear();
+}
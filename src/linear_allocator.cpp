@@ -0,0 +1,76 @@
+#include <algorithm>
+#include "spock/linear_allocator.hpp"
+#include "spock/core.hpp"
+#include "spock/internal.hpp"
+#include "spock/util.hpp"
+
+using namespace spock;
+
+//everything transient data is typically bound as
+constexpr VkBufferUsageFlags LINEAR_BUFFER_USAGE = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                                   VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                                   VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+static LinearAllocator::Block create_block(VkDeviceSize size) {
+    LinearAllocator::Block block;
+    //lands in device local memory on ReBAR/UMA devices
+    block.buffer = create_buffer(size, LINEAR_BUFFER_USAGE, MemoryIntent::Upload);
+    VkBufferDeviceAddressInfo addressInfo{.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = block.buffer.buffer};
+    block.address = vkGetBufferDeviceAddress(ctx.device, &addressInfo);
+    return block;
+}
+
+static VkDeviceSize align_up(VkDeviceSize v, VkDeviceSize alignment) {
+    return (v + alignment - 1) / alignment * alignment;
+}
+
+void LinearAllocator::init(VkDeviceSize size) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(ctx.physicalDevice, &props);
+    minAlignment = std::max(props.limits.minUniformBufferOffsetAlignment, props.limits.minStorageBufferOffsetAlignment);
+    blockSize    = size;
+    blocks.push_back(create_block(blockSize));
+    current = 0;
+    head    = 0;
+}
+
+void LinearAllocator::destroy() {
+    for (auto& block : blocks) {
+        destroy_buffer(block.buffer);
+    }
+    blocks.clear();
+}
+
+TransientAllocation LinearAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+    alignment = std::max(alignment, minAlignment);
+    std::lock_guard<std::mutex> lock(mutex);
+
+    VkDeviceSize offset = align_up(head, alignment);
+    while (offset + size > blocks[current].buffer.info.size) {
+        //next block, creating one big enough if the remaining ones aren't
+        current++;
+        if (current == blocks.size() || blocks[current].buffer.info.size < size)
+            blocks.insert(blocks.begin() + current, create_block(std::max(blockSize, size)));
+        offset = 0;
+    }
+    head = offset + size;
+
+    Block& block = blocks[current];
+    return {block.buffer.buffer, offset, size, (char*)block.buffer.info.pMappedData + offset, block.address + offset};
+}
+
+void LinearAllocator::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (uint32_t i = 0; i <= current && i < blocks.size(); i++) {
+        vmaFlushAllocation(ctx.allocator, blocks[i].buffer.allocation, 0, i == current ? head : VK_WHOLE_SIZE);
+    }
+}
+
+void LinearAllocator::reset() {
+    current = 0;
+    head    = 0;
+}
+
+TransientAllocation spock::frame_allocate(VkDeviceSize size, VkDeviceSize alignment) {
+    return get_frame().linearAllocator.allocate(size, alignment);
+}
@@ -0,0 +1,93 @@
+#include <atomic>
+#include <mutex>
+#include "spock/memory.hpp"
+#include "spock/internal.hpp"
+
+using namespace spock;
+
+constexpr size_t TAG_COUNT = (size_t)MemoryTag::Count;
+
+static struct MemoryTracker {
+    std::atomic<VkDeviceSize> tagBytes[TAG_COUNT]       = {};
+    std::atomic<uint32_t>     tagAllocations[TAG_COUNT] = {};
+    std::atomic<VkDeviceSize> heapBytes[VK_MAX_MEMORY_HEAPS] = {};
+    std::mutex                budgetMutex;
+    VmaBudget                 budgets[VK_MAX_MEMORY_HEAPS] = {};
+} tracker;
+
+static uint32_t heap_index(uint32_t memoryType) {
+    const VkPhysicalDeviceMemoryProperties* props;
+    vmaGetMemoryProperties(ctx.allocator, &props);
+    return props->memoryTypes[memoryType].heapIndex;
+}
+
+void spock::track_allocation(VmaAllocation allocation, MemoryTag tag) {
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(ctx.allocator, allocation, &info);
+    //tag + 1, so allocations that were never tracked (null user data) are ignored on untrack
+    vmaSetAllocationUserData(ctx.allocator, allocation, (void*)((uintptr_t)tag + 1));
+    tracker.tagBytes[(size_t)tag] += info.size;
+    tracker.tagAllocations[(size_t)tag]++;
+    tracker.heapBytes[heap_index(info.memoryType)] += info.size;
+}
+
+void spock::untrack_allocation(VmaAllocation allocation) {
+    if (allocation == VK_NULL_HANDLE)
+        return;
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(ctx.allocator, allocation, &info);
+    uintptr_t tagged = (uintptr_t)info.pUserData;
+    if (tagged == 0)
+        return;
+    size_t tag = tagged - 1;
+    tracker.tagBytes[tag] -= info.size;
+    tracker.tagAllocations[tag]--;
+    tracker.heapBytes[heap_index(info.memoryType)] -= info.size;
+}
+
+void spock::update_memory_budget() {
+    std::lock_guard<std::mutex> lock(tracker.budgetMutex);
+    //vma only re-queries VK_EXT_memory_budget when the frame index changes (or every ~30 allocations)
+    vmaSetCurrentFrameIndex(ctx.allocator, ctx.frameIdx);
+    vmaGetHeapBudgets(ctx.allocator, tracker.budgets);
+}
+
+MemoryStats spock::get_memory_stats() {
+    MemoryStats stats;
+    for (size_t i = 0; i < TAG_COUNT; i++) {
+        stats.tagBytes[i]       = tracker.tagBytes[i];
+        stats.tagAllocations[i] = tracker.tagAllocations[i];
+    }
+
+    const VkPhysicalDeviceMemoryProperties* props;
+    vmaGetMemoryProperties(ctx.allocator, &props);
+    std::lock_guard<std::mutex> lock(tracker.budgetMutex);
+    stats.heaps.resize(props->memoryHeapCount);
+    for (uint32_t i = 0; i < props->memoryHeapCount; i++) {
+        stats.heaps[i] = {tracker.budgets[i].budget, tracker.budgets[i].usage, tracker.heapBytes[i],
+                          (props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0};
+    }
+    return stats;
+}
+
+bool spock::over_memory_budget() {
+    const VkPhysicalDeviceMemoryProperties* props;
+    vmaGetMemoryProperties(ctx.allocator, &props);
+    std::lock_guard<std::mutex> lock(tracker.budgetMutex);
+    for (uint32_t i = 0; i < props->memoryHeapCount; i++) {
+        if (tracker.budgets[i].usage > tracker.budgets[i].budget)
+            return true;
+    }
+    return false;
+}
+
+const char* spock::memory_tag_name(MemoryTag tag) {
+    switch (tag) {
+        case MemoryTag::General: return "general";
+        case MemoryTag::Textures: return "textures";
+        case MemoryTag::Meshes: return "meshes";
+        case MemoryTag::RenderTargets: return "render targets";
+        case MemoryTag::Staging: return "staging";
+        default: return "unknown";
+    }
+}
@@ -1,8 +1,16 @@
 #include "spock/pipeline_builder.hpp"
 #include "spock/internal.hpp"
 #include "spock/util.hpp"
+#include "spock/trace.hpp"
+#include "spock/layout_cache.hpp"
 #include <vulkan/vulkan_core.h>
 #include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 VkPipelineColorBlendAttachmentState color_blend(Blend color, Blend alpha) {
     return {
@@ -189,17 +197,10 @@ GraphicsPipelineBuilder& GraphicsPipelineBuilder::set_dynamic_states(std::initia
 }
 
 VkPipeline GraphicsPipelineBuilder::build() {
+    SPOCK_TRACE_SCOPE("GraphicsPipelineBuilder::build");
+    //the layout cache owns it, builders with the same layouts share one
     if (layout == VK_NULL_HANDLE)
-    {
-        VkPipelineLayoutCreateInfo layoutInfo{};
-        layoutInfo.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        layoutInfo.pNext                  = nullptr;
-        layoutInfo.pSetLayouts            = descriptorSetLayouts.data();
-        layoutInfo.setLayoutCount         = descriptorSetLayouts.size();
-        layoutInfo.pPushConstantRanges    = pushConstantRanges.data();
-        layoutInfo.pushConstantRangeCount = pushConstantRanges.size();
-        VK_CHECK(vkCreatePipelineLayout(spock::ctx.device, &layoutInfo, nullptr, &layout));
-    }
+        layout = spock::cached_pipeline_layout(descriptorSetLayouts.data(), descriptorSetLayouts.size(), pushConstantRanges.data(), pushConstantRanges.size());
 
     VkGraphicsPipelineCreateInfo info = {};
     info.sType                        = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -214,6 +215,8 @@ VkPipeline GraphicsPipelineBuilder::build() {
     };
     info.pNext                             = &_r;
     info.flags                             = flags;
+    if (spock::uses_descriptor_buffer(layout))
+        info.flags |= VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
     info.stageCount                        = stages.size();
     info.pStages                           = stages.data();
     info.pVertexInputState                 = &vertexInputState;
@@ -260,13 +263,12 @@ VkPipeline GraphicsPipelineBuilder::build() {
     info.layout                         = layout;
     //the rest are unused parameters
 
-    if (vkCreateGraphicsPipelines(spock::ctx.device, VK_NULL_HANDLE, 1, &info, nullptr, &pipeline) != VK_SUCCESS) {
+    if (vkCreateGraphicsPipelines(spock::ctx.device, spock::ctx.pipelineCache, 1, &info, nullptr, &pipeline) != VK_SUCCESS) {
         printf("Failed to create pipeline\n");
         abort();
     }
 
     QUEUE_DESTROY_OBJ(pipeline);
-    QUEUE_DESTROY_OBJ(layout);
     return pipeline;
 }
 
@@ -292,17 +294,10 @@ ComputePipelineBuilder& ComputePipelineBuilder::set_push_constant_ranges(std::in
 }
 
 VkPipeline ComputePipelineBuilder::build() {
+    SPOCK_TRACE_SCOPE("ComputePipelineBuilder::build");
+    //the layout cache owns it, builders with the same layouts share one
     if (layout == VK_NULL_HANDLE)
-    {
-        VkPipelineLayoutCreateInfo layoutInfo{};
-        layoutInfo.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        layoutInfo.pNext                  = nullptr;
-        layoutInfo.pSetLayouts            = descriptorSetLayouts.data();
-        layoutInfo.setLayoutCount         = descriptorSetLayouts.size();
-        layoutInfo.pPushConstantRanges    = pushConstantRanges.data();
-        layoutInfo.pushConstantRangeCount = pushConstantRanges.size();
-        VK_CHECK(vkCreatePipelineLayout(spock::ctx.device, &layoutInfo, nullptr, &layout));
-    }
+        layout = spock::cached_pipeline_layout(descriptorSetLayouts.data(), descriptorSetLayouts.size(), pushConstantRanges.data(), pushConstantRanges.size());
 
     VkPipelineShaderStageCreateInfo stageInfo{};
     stageInfo.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -315,11 +310,110 @@ VkPipeline ComputePipelineBuilder::build() {
     computePipelineCreateInfo.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
     computePipelineCreateInfo.pNext  = nullptr;
     computePipelineCreateInfo.layout = layout;
+    if (spock::uses_descriptor_buffer(layout))
+        computePipelineCreateInfo.flags |= VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
     computePipelineCreateInfo.stage  = stageInfo;
 
-    VK_CHECK(vkCreateComputePipelines(spock::ctx.device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &pipeline));
+    VK_CHECK(vkCreateComputePipelines(spock::ctx.device, spock::ctx.pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline));
 
     QUEUE_DESTROY_OBJ(pipeline);
-    QUEUE_DESTROY_OBJ(layout);
     return pipeline;
 }
+
+//persistent helper threads, started on first use and kept until cleanup, so repeated batches
+//don't pay for thread creation (or per-thread trace buffers) every time
+static struct PipelineWorkers {
+    std::mutex                   batchMutex; //one batch at a time
+    std::mutex                   mutex;
+    std::condition_variable      wake;
+    std::condition_variable      idle;
+    std::vector<std::thread>     threads;
+    const std::function<void()>* job     = nullptr;
+    uint32_t                     wanted  = 0; //helpers that may still join the current job
+    uint32_t                     running = 0;
+    bool                         quit    = false;
+} workers;
+
+static void worker_loop() {
+    std::unique_lock<std::mutex> lock(workers.mutex);
+    for (;;) {
+        workers.wake.wait(lock, [] { return workers.quit || workers.wanted > 0; });
+        if (workers.quit)
+            return;
+        workers.wanted--;
+        workers.running++;
+        const std::function<void()>* job = workers.job;
+        lock.unlock();
+        (*job)();
+        lock.lock();
+        if (--workers.running == 0)
+            workers.idle.notify_all();
+    }
+}
+
+void destroy_pipeline_workers() {
+    {
+        std::lock_guard<std::mutex> lock(workers.mutex);
+        workers.quit = true;
+    }
+    workers.wake.notify_all();
+    for (auto& t : workers.threads) {
+        t.join();
+    }
+    workers.threads.clear();
+    workers.quit = false;
+}
+
+//workers pull the next builder off a shared index, so one slow pipeline doesn't stall a whole chunk.
+//build() is safe to run concurrently: the layout cache and destroy queue lock, the pipeline cache is
+//internally synchronized
+template <typename Builder>
+static std::vector<PipelineBuildResult> build_parallel(std::span<Builder> builders, uint32_t threadCount) {
+    SPOCK_TRACE_SCOPE("build_pipelines");
+    std::vector<PipelineBuildResult> results(builders.size());
+    if (threadCount == 0)
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    threadCount = std::min<uint32_t>(threadCount, builders.size());
+
+    std::atomic<size_t>   next = 0;
+    std::function<void()> work = [&]() {
+        for (size_t i = next++; i < builders.size(); i = next++) {
+            uint64_t start = spock::trace_now();
+            results[i].pipeline = builders[i].build();
+            results[i].ms       = (spock::trace_now() - start) / 1e6;
+        }
+    };
+    if (threadCount <= 1) {
+        work();
+        return results;
+    }
+
+    std::lock_guard<std::mutex> batchLock(workers.batchMutex);
+    {
+        std::lock_guard<std::mutex> lock(workers.mutex);
+        while (workers.threads.size() < threadCount - 1) {
+            workers.threads.emplace_back(worker_loop);
+        }
+        workers.job    = &work;
+        workers.wanted = threadCount - 1;
+    }
+    workers.wake.notify_all();
+
+    //the calling thread is one of the workers
+    work();
+
+    //every builder is taken, helpers that haven't started have nothing left to do
+    std::unique_lock<std::mutex> lock(workers.mutex);
+    workers.wanted = 0;
+    workers.idle.wait(lock, [] { return workers.running == 0; });
+    workers.job = nullptr;
+    return results;
+}
+
+std::vector<PipelineBuildResult> build_pipelines(std::span<GraphicsPipelineBuilder> builders, uint32_t threadCount) {
+    return build_parallel(builders, threadCount);
+}
+
+std::vector<PipelineBuildResult> build_pipelines(std::span<ComputePipelineBuilder> builders, uint32_t threadCount) {
+    return build_parallel(builders, threadCount);
+}
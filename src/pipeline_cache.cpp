@@ -0,0 +1,120 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "spock/pipeline_cache.hpp"
+#include "spock/internal.hpp"
+#include "spock/trace.hpp"
+#include "spock/util.hpp"
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace spock;
+
+static std::string cachePath;
+
+//the driver rejects or silently ignores foreign data, but some crash on it. check the header ourselves
+static bool valid_cache_data(const std::vector<char>& data) {
+    VkPipelineCacheHeaderVersionOne header;
+    if (data.size() < sizeof(header))
+        return false;
+    memcpy(&header, data.data(), sizeof(header));
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(ctx.physicalDevice, &props);
+    return header.headerSize >= sizeof(header) && data.size() >= header.headerSize && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == props.vendorID && header.deviceID == props.deviceID &&
+           memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+static std::vector<char> read_file(const char* path) {
+    std::vector<char> data;
+    FILE*             f = fopen(path, "rb");
+    if (!f)
+        return data;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size > 0) {
+        data.resize(size);
+        if (fread(data.data(), 1, size, f) != (size_t)size)
+            data.clear();
+    }
+    fclose(f);
+    return data;
+}
+
+void spock::init_pipeline_cache(const char* path) {
+    SPOCK_TRACE_SCOPE("init_pipeline_cache");
+    cachePath = path ? path : "";
+
+    std::vector<char> data;
+    if (!cachePath.empty()) {
+        data = read_file(cachePath.c_str());
+        if (!data.empty() && !valid_cache_data(data)) {
+            printf("Pipeline cache %s was created by another device or driver, ignoring it\n", cachePath.c_str());
+            data.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo info{
+        .sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = data.size(),
+        .pInitialData    = data.empty() ? nullptr : data.data(),
+    };
+    VK_CHECK(vkCreatePipelineCache(ctx.device, &info, nullptr, &ctx.pipelineCache));
+}
+
+bool spock::save_pipeline_cache(const char* path) {
+    SPOCK_TRACE_SCOPE("save_pipeline_cache");
+    std::string target = path ? path : cachePath;
+    if (target.empty() || ctx.pipelineCache == VK_NULL_HANDLE)
+        return false;
+
+    //pipelines built on other threads can grow the cache between the two calls, the data is then
+    //truncated with VK_INCOMPLETE and would fail the header check on load. query again until it fits
+    size_t            size = 0;
+    std::vector<char> data;
+    VkResult          result;
+    do {
+        VK_CHECK(vkGetPipelineCacheData(ctx.device, ctx.pipelineCache, &size, nullptr));
+        data.resize(size);
+        result = vkGetPipelineCacheData(ctx.device, ctx.pipelineCache, &size, data.data());
+    } while (result == VK_INCOMPLETE);
+    if (result != VK_SUCCESS)
+        return false;
+
+    std::string tmp = target + ".tmp";
+    FILE*       f   = fopen(tmp.c_str(), "wb");
+    if (!f)
+        return false;
+    bool written = fwrite(data.data(), 1, size, f) == size && fflush(f) == 0;
+    //on disk before the rename, otherwise a power loss can leave the renamed file empty
+#ifdef _WIN32
+    written = written && _commit(_fileno(f)) == 0;
+#else
+    written = written && fsync(fileno(f)) == 0;
+#endif
+    written = fclose(f) == 0 && written;
+
+    std::error_code ec;
+    if (written)
+        std::filesystem::rename(tmp, target, ec);
+    if (!written || ec) {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+void spock::destroy_pipeline_cache() {
+    if (ctx.pipelineCache == VK_NULL_HANDLE)
+        return;
+    save_pipeline_cache();
+    vkDestroyPipelineCache(ctx.device, ctx.pipelineCache, nullptr);
+    ctx.pipelineCache = VK_NULL_HANDLE;
+}
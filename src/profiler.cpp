@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <atomic>
+#include "spock/profiler.hpp"
+#include "spock/internal.hpp"
+#include "spock/util.hpp"
+
+using namespace spock;
+
+struct ScopeRecord {
+    std::string name;
+    uint32_t    parent;
+    uint32_t    depth;
+};
+
+//queries 2i and 2i+1 are the begin and end timestamps of scope i
+struct ProfilerFrame {
+    VkQueryPool              pool = VK_NULL_HANDLE;
+    std::atomic<uint32_t>    next = 0; //scopes handed out this frame, may run past maxScopes
+    std::vector<ScopeRecord> scopes;
+};
+
+static struct GpuProfiler {
+    std::vector<ProfilerFrame> frames;
+    uint32_t                   maxScopes     = 0;
+    double                     nsPerTick     = 1.0;
+    uint64_t                   timestampMask = ~0ull;
+    std::vector<GpuTiming>     timings;
+    std::vector<uint64_t>      results;
+} profiler;
+
+//open scope on this thread, for nesting
+static thread_local uint32_t currentScope = UINT32_MAX;
+static thread_local uint32_t currentDepth = 0;
+
+void spock::init_gpu_profiler(uint32_t maxScopes) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(ctx.physicalDevice, &props);
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(ctx.physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(ctx.physicalDevice, &familyCount, families.data());
+    uint32_t validBits = families[ctx.graphicsQueueFamily].timestampValidBits;
+
+    //no timestamp support on the graphics queue, scopes become no-ops
+    if (maxScopes == 0 || validBits == 0)
+        return;
+
+    profiler.maxScopes     = maxScopes;
+    profiler.nsPerTick     = props.limits.timestampPeriod;
+    profiler.timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    profiler.frames        = std::vector<ProfilerFrame>(ctx.frameOverlap);
+
+    VkQueryPoolCreateInfo poolInfo{.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    poolInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = maxScopes * 2;
+    for (auto& f : profiler.frames) {
+        VK_CHECK(vkCreateQueryPool(ctx.device, &poolInfo, nullptr, &f.pool));
+        //queries have to be reset before first use
+        vkResetQueryPool(ctx.device, f.pool, 0, poolInfo.queryCount);
+        f.scopes.resize(maxScopes);
+    }
+}
+
+void spock::destroy_gpu_profiler() {
+    for (auto& f : profiler.frames) {
+        vkDestroyQueryPool(ctx.device, f.pool, nullptr);
+    }
+    profiler.frames.clear();
+    profiler.timings.clear();
+    profiler.maxScopes = 0;
+}
+
+void spock::collect_gpu_profiler() {
+    if (profiler.frames.empty())
+        return;
+    ProfilerFrame& f     = profiler.frames[get_frame_number()];
+    uint32_t       count = std::min(f.next.load(), profiler.maxScopes);
+    if (count == 0)
+        return;
+
+    //value + availability per query. unavailable means the frame was recorded but never submitted
+    profiler.results.resize(count * 4);
+    VkResult result = vkGetQueryPoolResults(ctx.device, f.pool, 0, count * 2, profiler.results.size() * sizeof(uint64_t), profiler.results.data(),
+                                            2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    bool     available = result == VK_SUCCESS;
+    for (uint32_t i = 0; available && i < count * 2; i++) {
+        available = profiler.results[i * 2 + 1] != 0;
+    }
+
+    if (available) {
+        profiler.timings.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            uint64_t begin      = profiler.results[i * 4];
+            uint64_t end        = profiler.results[i * 4 + 2];
+            uint64_t ticks      = (end - begin) & profiler.timestampMask;
+            profiler.timings[i] = {f.scopes[i].name, f.scopes[i].parent, f.scopes[i].depth, ticks * profiler.nsPerTick / 1e6};
+        }
+    }
+
+    vkResetQueryPool(ctx.device, f.pool, 0, count * 2);
+    f.next = 0;
+}
+
+GpuScope::GpuScope(VkCommandBuffer cmd, const char* name) : cmd(cmd), index(UINT32_MAX), parent(UINT32_MAX) {
+    if (profiler.frames.empty())
+        return;
+    ProfilerFrame& f = profiler.frames[get_frame_number()];
+    uint32_t       i = f.next.fetch_add(1);
+    if (i >= profiler.maxScopes)
+        return;
+
+    index        = i;
+    parent       = currentScope;
+    f.scopes[i]  = {name, currentScope, currentDepth};
+    currentScope = i;
+    currentDepth++;
+    //ALL_COMMANDS on both ends waits for preceding work, so the interval covers only this scope
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, f.pool, i * 2);
+}
+
+GpuScope::~GpuScope() {
+    if (index == UINT32_MAX)
+        return;
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, profiler.frames[get_frame_number()].pool, index * 2 + 1);
+    currentScope = parent;
+    currentDepth--;
+}
+
+const std::vector<GpuTiming>& spock::gpu_timings() {
+    return profiler.timings;
+}
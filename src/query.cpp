@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <bit>
+#include "spock/query.hpp"
+#include "spock/internal.hpp"
+#include "spock/util.hpp"
+
+using namespace spock;
+
+constexpr uint32_t QUERY_POOL_SIZE = 128;
+
+//the counters in PipelineStatistics, result order follows bit order
+constexpr VkQueryPipelineStatisticFlags PIPELINE_STATISTICS =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT | VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+static_assert(sizeof(PipelineStatistics) == 7 * sizeof(uint64_t));
+
+void QueryAllocator::init(VkQueryType type, uint32_t poolSize, VkQueryPipelineStatisticFlags statistics) {
+    this->type       = type;
+    this->poolSize   = poolSize;
+    this->statistics = statistics;
+    valuesPerQuery   = type == VK_QUERY_TYPE_PIPELINE_STATISTICS ? std::popcount(statistics) : 1;
+    used             = 0;
+}
+
+void QueryAllocator::destroy() {
+    for (auto pool : pools) {
+        vkDestroyQueryPool(ctx.device, pool, nullptr);
+    }
+    pools.clear();
+    names.clear();
+    ids.clear();
+    used = 0;
+}
+
+QueryAllocator::Slot QueryAllocator::allocate(const char* name, uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t                    index = used++;
+    if (index / poolSize == pools.size()) {
+        VkQueryPoolCreateInfo poolInfo{.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+        poolInfo.queryType          = type;
+        poolInfo.queryCount         = poolSize;
+        poolInfo.pipelineStatistics = statistics;
+        VkQueryPool pool;
+        VK_CHECK(vkCreateQueryPool(ctx.device, &poolInfo, nullptr, &pool));
+        //queries have to be reset before first use
+        vkResetQueryPool(ctx.device, pool, 0, poolSize);
+        pools.push_back(pool);
+    }
+    names.emplace_back(name ? name : "");
+    ids.push_back(id);
+    return {pools[index / poolSize], index % poolSize, index};
+}
+
+QueryAllocator::Slot QueryAllocator::slot(uint32_t index) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return {pools[index / poolSize], index % poolSize, index};
+}
+
+bool QueryAllocator::read(std::vector<uint64_t>& out) {
+    //values followed by the availability word
+    uint32_t stride = valuesPerQuery + 1;
+    out.resize(used * stride);
+    for (uint32_t first = 0; first < used; first += poolSize) {
+        uint32_t count  = std::min(poolSize, used - first);
+        VkResult result = vkGetQueryPoolResults(ctx.device, pools[first / poolSize], 0, count, count * stride * sizeof(uint64_t), out.data() + first * stride,
+                                                stride * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (result != VK_SUCCESS)
+            return false;
+    }
+    for (uint32_t i = 0; i < used; i++) {
+        if (out[i * stride + valuesPerQuery] == 0)
+            return false;
+    }
+    //drop the availability words
+    for (uint32_t i = 0; i < used; i++) {
+        std::copy_n(out.begin() + i * stride, valuesPerQuery, out.begin() + i * valuesPerQuery);
+    }
+    out.resize(used * valuesPerQuery);
+    return true;
+}
+
+void QueryAllocator::reset() {
+    for (uint32_t first = 0; first < used; first += poolSize) {
+        vkResetQueryPool(ctx.device, pools[first / poolSize], 0, std::min(poolSize, used - first));
+    }
+    names.clear();
+    ids.clear();
+    used = 0;
+}
+
+static struct QueryResults {
+    std::vector<PipelineStatisticsResult> statistics;
+    std::vector<OcclusionResult>          occlusion;
+    std::vector<uint64_t>                 values;
+} results;
+
+void spock::init_queries() {
+    for (auto& frame : ctx.frames) {
+        frame.statisticsQueries.init(VK_QUERY_TYPE_PIPELINE_STATISTICS, QUERY_POOL_SIZE, PIPELINE_STATISTICS);
+        frame.occlusionQueries.init(VK_QUERY_TYPE_OCCLUSION, QUERY_POOL_SIZE);
+    }
+}
+
+void spock::destroy_queries() {
+    for (auto& frame : ctx.frames) {
+        frame.statisticsQueries.destroy();
+        frame.occlusionQueries.destroy();
+    }
+    results.statistics.clear();
+    results.occlusion.clear();
+}
+
+void spock::collect_queries() {
+    FrameContext& frame = get_frame();
+
+    QueryAllocator& statistics = frame.statisticsQueries;
+    if (statistics.used > 0 && statistics.read(results.values)) {
+        results.statistics.resize(statistics.used);
+        for (uint32_t i = 0; i < statistics.used; i++) {
+            results.statistics[i].name = statistics.names[i];
+            std::copy_n(results.values.begin() + i * statistics.valuesPerQuery, statistics.valuesPerQuery,
+                        reinterpret_cast<uint64_t*>(&results.statistics[i].stats));
+        }
+    }
+    statistics.reset();
+
+    QueryAllocator& occlusion = frame.occlusionQueries;
+    if (occlusion.used > 0 && occlusion.read(results.values)) {
+        results.occlusion.resize(occlusion.used);
+        for (uint32_t i = 0; i < occlusion.used; i++) {
+            results.occlusion[i] = {occlusion.ids[i], results.values[i]};
+        }
+    }
+    occlusion.reset();
+}
+
+uint32_t spock::begin_pipeline_statistics(VkCommandBuffer cmd, const char* name) {
+    if (!ctx.pipelineStatisticsQuery)
+        return UINT32_MAX;
+    auto slot = get_frame().statisticsQueries.allocate(name, 0);
+    vkCmdBeginQuery(cmd, slot.pool, slot.query, 0);
+    return slot.index;
+}
+
+void spock::end_pipeline_statistics(VkCommandBuffer cmd, uint32_t handle) {
+    if (handle == UINT32_MAX)
+        return;
+    auto slot = get_frame().statisticsQueries.slot(handle);
+    vkCmdEndQuery(cmd, slot.pool, slot.query);
+}
+
+uint32_t spock::begin_occlusion_query(VkCommandBuffer cmd, uint64_t id, bool precise) {
+    auto slot = get_frame().occlusionQueries.allocate(nullptr, id);
+    vkCmdBeginQuery(cmd, slot.pool, slot.query, precise && ctx.occlusionQueryPrecise ? VK_QUERY_CONTROL_PRECISE_BIT : 0);
+    return slot.index;
+}
+
+void spock::end_occlusion_query(VkCommandBuffer cmd, uint32_t handle) {
+    auto slot = get_frame().occlusionQueries.slot(handle);
+    vkCmdEndQuery(cmd, slot.pool, slot.query);
+}
+
+const std::vector<PipelineStatisticsResult>& spock::pipeline_statistics_results() {
+    return results.statistics;
+}
+
+const std::vector<OcclusionResult>& spock::occlusion_results() {
+    return results.occlusion;
+}
@@ -8,6 +8,7 @@
 #include "spock/internal.hpp"
 
 #include "spock/shader.hpp"
+#include "spock/trace.hpp"
 
 void error_exit();
 //Shaders
@@ -104,6 +105,7 @@ class DirStackFileIncluder : public glslang::TShader::Includer {
 
 
 std::vector<uint32_t> spock::glsl_to_spirv(const char* const* shaderSource, EShLanguage stage, const char* filePath) {
+    SPOCK_TRACE_SCOPE("glsl_to_spirv");
     glslang::InitializeProcess();
     DirStackFileIncluder includer;
     includer.pushExternalLocalDirectory(getDirectory(filePath));
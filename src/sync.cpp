@@ -0,0 +1,141 @@
+#include "spock/sync.hpp"
+#include "spock/info.hpp"
+#include "spock/internal.hpp"
+#include "spock/util.hpp"
+
+using namespace spock;
+
+void Timeline::init() {
+    VkSemaphoreTypeCreateInfo typeInfo = {
+        .sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .pNext         = nullptr,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue  = 0,
+    };
+    VkSemaphoreCreateInfo info = info::create::semaphore();
+    info.pNext                 = &typeInfo;
+    VK_CHECK(vkCreateSemaphore(ctx.device, &info, nullptr, &semaphore));
+    value = 0;
+}
+
+void Timeline::destroy() {
+    vkDestroySemaphore(ctx.device, semaphore, nullptr);
+    semaphore = VK_NULL_HANDLE;
+}
+
+uint64_t Timeline::completed_value() const {
+    uint64_t completed = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(ctx.device, semaphore, &completed));
+    return completed;
+}
+
+bool Timeline::reached(uint64_t target) const {
+    return completed_value() >= target;
+}
+
+void Timeline::wait(uint64_t target) const {
+    if (target == 0)
+        return;
+    VkSemaphoreWaitInfo waitInfo = {
+        .sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .pNext          = nullptr,
+        .flags          = 0,
+        .semaphoreCount = 1,
+        .pSemaphores    = &semaphore,
+        .pValues        = &target,
+    };
+    VK_CHECK(vkWaitSemaphores(ctx.device, &waitInfo, UINT64_MAX));
+}
+
+uint64_t spock::submit(VkQueue queue, Timeline& timeline, VkCommandBuffer cmd, std::initializer_list<VkSemaphoreSubmitInfo> waits,
+                       std::initializer_list<VkSemaphoreSubmitInfo> signals) {
+    return submit(queue, timeline, cmd, std::data(waits), uint32_t(waits.size()), std::data(signals), uint32_t(signals.size()));
+}
+
+uint64_t spock::submit(VkQueue queue, Timeline& timeline, VkCommandBuffer cmd, const VkSemaphoreSubmitInfo* waits, uint32_t waitCount,
+                       const VkSemaphoreSubmitInfo* signals, uint32_t signalCount) {
+    //max 8 signals, one slot is reserved for the timeline
+    assert(signalCount < 8);
+    VkSemaphoreSubmitInfo signalInfos[8];
+    for (uint32_t i = 0; i < signalCount; i++) {
+        signalInfos[i] = signals[i];
+    }
+
+    VkCommandBufferSubmitInfo cmdInfo = info::submit::command_buffer(cmd);
+
+    std::lock_guard<std::mutex> lock(timeline.mutex);
+    uint64_t                    value = timeline.value + 1;
+    signalInfos[signalCount++]        = info::submit::semaphore(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, timeline.semaphore, value);
+
+    VkSubmitInfo2 submitInfo            = {};
+    submitInfo.sType                    = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    submitInfo.pNext                    = nullptr;
+    submitInfo.waitSemaphoreInfoCount   = waitCount;
+    submitInfo.pWaitSemaphoreInfos      = waits;
+    submitInfo.signalSemaphoreInfoCount = signalCount;
+    submitInfo.pSignalSemaphoreInfos    = signalInfos;
+    submitInfo.commandBufferInfoCount   = cmd == VK_NULL_HANDLE ? 0 : 1;
+    submitInfo.pCommandBufferInfos      = cmd == VK_NULL_HANDLE ? nullptr : &cmdInfo;
+    VK_CHECK(vkQueueSubmit2(queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+    //only publish the value once it is actually queued
+    timeline.value = value;
+    return value;
+}
+
+bool Ticket::ready() const {
+    return timeline == nullptr || timeline->reached(value);
+}
+
+void Ticket::wait() const {
+    if (timeline != nullptr)
+        timeline->wait(value);
+}
+
+VkSemaphoreSubmitInfo Ticket::wait_info(VkPipelineStageFlags2 stageMask) const {
+    //an empty ticket waits on value 0 of the graphics timeline, which is always signalled
+    if (timeline == nullptr)
+        return info::submit::semaphore(stageMask, ctx.timeline.semaphore, 0);
+    return info::submit::semaphore(stageMask, timeline->semaphore, value);
+}
+
+void CommandBufferPool::init(uint32_t queueFamily, Timeline* _timeline) {
+    timeline             = _timeline;
+    auto commandPoolInfo = info::create::command_pool(queueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    VK_CHECK(vkCreateCommandPool(ctx.device, &commandPoolInfo, nullptr, &pool));
+}
+
+void CommandBufferPool::destroy() {
+    //frees every command buffer allocated from it
+    vkDestroyCommandPool(ctx.device, pool, nullptr);
+    pool = VK_NULL_HANDLE;
+    entries.clear();
+}
+
+VkCommandBuffer CommandBufferPool::acquire() {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t                    completed = timeline->completed_value();
+    for (auto& e : entries) {
+        if (e.value != RECORDING && e.value <= completed) {
+            e.value = RECORDING;
+            VK_CHECK(vkResetCommandBuffer(e.cmd, 0));
+            return e.cmd;
+        }
+    }
+
+    VkCommandBuffer             cmd;
+    VkCommandBufferAllocateInfo cmdAllocInfo = info::allocate::command_buffer(pool, 1);
+    VK_CHECK(vkAllocateCommandBuffers(ctx.device, &cmdAllocInfo, &cmd));
+    entries.push_back({cmd, RECORDING});
+    return cmd;
+}
+
+void CommandBufferPool::release(VkCommandBuffer cmd, uint64_t value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& e : entries) {
+        if (e.cmd == cmd) {
+            e.value = value;
+            return;
+        }
+    }
+}
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "spock/trace.hpp"
+
+using namespace spock;
+
+constexpr uint32_t TRACE_EVENTS_PER_THREAD = 1 << 16;
+
+struct TraceEvent {
+    const char* name;
+    uint64_t    start;
+    uint64_t    end;
+};
+
+//written only by its thread. count is published after the event, so a reader sees complete events
+struct ThreadTrace {
+    uint32_t                tid;
+    bool                    live  = true; //owned by a running thread, guarded by tracer.mutex
+    std::atomic<uint32_t>   count = 0;
+    std::vector<TraceEvent> events;
+};
+
+static struct Tracer {
+    //off until the app opts in, a disabled TraceScope costs one relaxed load and allocates nothing
+    std::atomic<bool>                         enabled = false;
+    //buffers outlive their threads so events of finished workers are still exported. a new thread
+    //takes over a finished thread's buffer and appends to it, memory is bounded by the peak thread count
+    std::mutex                                mutex;
+    std::vector<std::unique_ptr<ThreadTrace>> threads;
+} tracer;
+
+//hands the buffer back when its thread exits
+struct ThreadTraceOwner {
+    ThreadTrace* trace = nullptr;
+    ~ThreadTraceOwner() {
+        if (!trace)
+            return;
+        std::lock_guard<std::mutex> lock(tracer.mutex);
+        trace->live = false;
+    }
+};
+
+static ThreadTrace& thread_trace() {
+    thread_local ThreadTraceOwner owner;
+    if (!owner.trace) {
+        std::lock_guard<std::mutex> lock(tracer.mutex);
+        for (auto& t : tracer.threads) {
+            if (!t->live) {
+                owner.trace = t.get();
+                break;
+            }
+        }
+        if (!owner.trace) {
+            auto t = std::make_unique<ThreadTrace>();
+            t->events.resize(TRACE_EVENTS_PER_THREAD);
+            t->tid      = tracer.threads.size();
+            owner.trace = t.get();
+            tracer.threads.push_back(std::move(t));
+        }
+        owner.trace->live = true;
+    }
+    return *owner.trace;
+}
+
+void spock::trace_enable(bool enable) {
+    tracer.enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool spock::trace_enabled() {
+    return tracer.enabled.load(std::memory_order_relaxed);
+}
+
+uint64_t spock::trace_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void spock::trace_event(const char* name, uint64_t start, uint64_t end) {
+    ThreadTrace& t = thread_trace();
+    uint32_t     i = t.count.load(std::memory_order_relaxed);
+    if (i >= TRACE_EVENTS_PER_THREAD)
+        return;
+    t.events[i] = {name, start, end};
+    t.count.store(i + 1, std::memory_order_release);
+}
+
+//names are usually literals, but don't let a quote or backslash break the json
+static void write_json_string(FILE* f, const char* s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(f, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            fprintf(f, "\\u%04x", *s);
+        else
+            fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+bool spock::trace_write(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f)
+        return false;
+
+    std::lock_guard<std::mutex> lock(tracer.mutex);
+    //timestamps relative to the earliest event, in microseconds
+    uint64_t                    origin = UINT64_MAX;
+    for (auto& t : tracer.threads) {
+        uint32_t count = t->count.load(std::memory_order_acquire);
+        for (uint32_t i = 0; i < count; i++) {
+            origin = std::min(origin, t->events[i].start);
+        }
+    }
+
+    fprintf(f, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (auto& t : tracer.threads) {
+        uint32_t count = t->count.load(std::memory_order_acquire);
+        for (uint32_t i = 0; i < count; i++) {
+            const TraceEvent& e = t->events[i];
+            fprintf(f, "%s{\"name\":", first ? "" : ",\n");
+            write_json_string(f, e.name);
+            fprintf(f, ",\"cat\":\"spock\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", t->tid, (e.start - origin) / 1000.0,
+                    (e.end - e.start) / 1000.0);
+            first = false;
+        }
+    }
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    return fclose(f) == 0;
+}
+
+void spock::trace_clear() {
+    std::lock_guard<std::mutex> lock(tracer.mutex);
+    for (auto& t : tracer.threads) {
+        t->count.store(0, std::memory_order_release);
+    }
+}
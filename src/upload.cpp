@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include "spock/upload.hpp"
+#include "spock/core.hpp"
+#include "spock/info.hpp"
+#include "spock/internal.hpp"
+#include "spock/util.hpp"
+
+using namespace spock;
+
+//satisfies buffer-image copy offset rules for every colour format
+constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+//persistently mapped staging memory, written at head and reclaimed from tail
+//once the submission that read it has completed on the gpu
+static struct StagingRing {
+    Buffer                                        buffer = {};
+    VkDeviceSize                                  size   = 0;
+    VkDeviceSize                                  head   = 0;
+    VkDeviceSize                                  tail   = 0;
+    bool                                          pending = false; //the open batch has written since its last submit
+    //submitted regions, oldest first: timeline value and the head at submit time
+    std::deque<std::pair<uint64_t, VkDeviceSize>> inFlight;
+} ring;
+
+static struct UploadBatch {
+    bool                                open = false;
+    VkCommandBuffer                     cmd  = VK_NULL_HANDLE;
+    //barriers after the copies, emitted once per submission. with a dedicated transfer
+    //queue they are the release half of the queue family ownership transfer
+    std::vector<VkImageMemoryBarrier2>  imageBarriers;
+    std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+    bool                                bufferUploads = false; //since the last submit
+} batch;
+
+static Timeline& upload_timeline() {
+    return ctx.dedicatedTransfer ? ctx.transferTimeline : ctx.timeline;
+}
+
+static CommandBufferPool& upload_commands() {
+    return ctx.dedicatedTransfer ? ctx.transferCommands : ctx.immCommands;
+}
+
+static VkDeviceSize align_up(VkDeviceSize v, VkDeviceSize alignment) {
+    return (v + alignment - 1) & ~(alignment - 1);
+}
+
+void spock::init_staging_ring(VkDeviceSize size) {
+    ring.size   = size;
+    ring.buffer = create_buffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryIntent::Upload, MemoryTag::Staging);
+    ring.head = ring.tail = 0;
+    ring.pending          = false;
+    ring.inFlight.clear();
+}
+
+void spock::destroy_staging_ring() {
+    destroy_buffer(ring.buffer);
+    ring.buffer = {};
+    ring.inFlight.clear();
+}
+
+static void reclaim_staging(uint64_t completed) {
+    while (!ring.inFlight.empty() && ring.inFlight.front().first <= completed) {
+        ring.tail = ring.inFlight.front().second;
+        ring.inFlight.pop_front();
+    }
+    //nothing in use, start from the beginning to get the largest contiguous range
+    if (ring.inFlight.empty() && !ring.pending)
+        ring.head = ring.tail = 0;
+}
+
+//returns the offset of a free range of size bytes, or false if the ring is too full right now
+static bool try_alloc_staging(VkDeviceSize size, VkDeviceSize& offset) {
+    bool         empty = ring.inFlight.empty() && !ring.pending;
+    VkDeviceSize start = align_up(ring.head, STAGING_ALIGNMENT);
+    if (empty) {
+        offset = 0;
+        return size <= ring.size;
+    }
+    if (ring.head > ring.tail || (ring.head == ring.tail && empty)) {
+        if (start + size <= ring.size) {
+            offset = start;
+            return true;
+        }
+        //wrap around, the bytes past head are skipped
+        if (size <= ring.tail) {
+            offset = 0;
+            return true;
+        }
+        return false;
+    }
+    if (ring.head < ring.tail && start + size <= ring.tail) {
+        offset = start;
+        return true;
+    }
+    return false;
+}
+
+static void record_barriers(VkCommandBuffer cmd, const std::vector<VkImageMemoryBarrier2>& imageBarriers,
+                            const std::vector<VkBufferMemoryBarrier2>& bufferBarriers) {
+    if (imageBarriers.empty() && bufferBarriers.empty())
+        return;
+    VkDependencyInfo depInfo         = {.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    depInfo.imageMemoryBarrierCount  = uint32_t(imageBarriers.size());
+    depInfo.pImageMemoryBarriers     = imageBarriers.data();
+    depInfo.bufferMemoryBarrierCount = uint32_t(bufferBarriers.size());
+    depInfo.pBufferMemoryBarriers    = bufferBarriers.data();
+    vkCmdPipelineBarrier2(cmd, &depInfo);
+}
+
+static void begin_batch_command() {
+    batch.cmd                             = upload_commands().acquire();
+    VkCommandBufferBeginInfo cmdBeginInfo = info::begin::command_buffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VK_CHECK(vkBeginCommandBuffer(batch.cmd, &cmdBeginInfo));
+}
+
+//records the matching acquire barriers on the graphics queue, ordered after the transfer submission
+static uint64_t acquire_on_graphics(uint64_t transferValue) {
+    std::vector<VkImageMemoryBarrier2>  imageBarriers  = batch.imageBarriers;
+    std::vector<VkBufferMemoryBarrier2> bufferBarriers = batch.bufferBarriers;
+    for (auto& b : imageBarriers) {
+        b.srcStageMask  = VK_PIPELINE_STAGE_2_NONE;
+        b.srcAccessMask = VK_ACCESS_2_NONE;
+        b.dstStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        b.dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT;
+    }
+    for (auto& b : bufferBarriers) {
+        b.srcStageMask  = VK_PIPELINE_STAGE_2_NONE;
+        b.srcAccessMask = VK_ACCESS_2_NONE;
+        b.dstStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        b.dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT;
+    }
+
+    VkCommandBuffer          cmd          = ctx.immCommands.acquire();
+    VkCommandBufferBeginInfo cmdBeginInfo = info::begin::command_buffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+    record_barriers(cmd, imageBarriers, bufferBarriers);
+    VK_CHECK(vkEndCommandBuffer(cmd));
+
+    uint64_t value = submit(ctx.graphicsQueue, ctx.timeline, cmd,
+                            {info::submit::semaphore(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, ctx.transferTimeline.semaphore, transferValue)});
+    ctx.immCommands.release(cmd, value);
+    return value;
+}
+
+//returns the graphics timeline value after which the uploads are visible to graphics queue work
+static uint64_t submit_batch_command() {
+    record_barriers(batch.cmd, batch.imageBarriers, batch.bufferBarriers);
+    VK_CHECK(vkEndCommandBuffer(batch.cmd));
+    uint64_t value;
+    if (ctx.dedicatedTransfer && batch.bufferUploads) {
+        //buffers may still be read by frames in flight, don't overwrite them before graphics is done
+        value = submit(ctx.transferQueue, upload_timeline(), batch.cmd,
+                       {info::submit::semaphore(VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, ctx.timeline.semaphore, ctx.timeline.value)});
+    } else {
+        value = submit(ctx.transferQueue, upload_timeline(), batch.cmd);
+    }
+    batch.bufferUploads = false;
+    upload_commands().release(batch.cmd, value);
+    batch.cmd = VK_NULL_HANDLE;
+
+    if (ring.pending)
+        ring.inFlight.push_back({value, ring.head});
+    ring.pending = false;
+
+    if (ctx.dedicatedTransfer)
+        value = acquire_on_graphics(value);
+    batch.imageBarriers.clear();
+    batch.bufferBarriers.clear();
+    return value;
+}
+
+//copies src into the ring, submitting the batch so far and waiting on the gpu only if the ring is full
+static VkDeviceSize write_staging(const void* src, VkDeviceSize size) {
+    //would wait forever for space, the callers split uploads into chunks that fit
+    if (size > ring.size) {
+        printf("Upload of %llu bytes doesn't fit the %llu byte staging ring\n", (unsigned long long)size, (unsigned long long)ring.size);
+        abort();
+    }
+    VkDeviceSize offset;
+    while (!try_alloc_staging(size, offset)) {
+        if (ring.inFlight.empty()) {
+            //the open batch itself filled the ring
+            submit_batch_command();
+            begin_batch_command();
+        }
+        upload_timeline().wait(ring.inFlight.front().first);
+        reclaim_staging(upload_timeline().completed_value());
+    }
+
+    ring.head    = offset + size;
+    ring.pending = true;
+    memcpy((char*)ring.buffer.info.pMappedData + offset, src, size);
+    //Upload memory isn't guaranteed to be coherent. no-op when it is
+    VK_CHECK(vmaFlushAllocation(ctx.allocator, ring.buffer.allocation, offset, size));
+    return offset;
+}
+
+//largest single transfer, anything bigger is split so it never needs the whole ring
+static VkDeviceSize max_chunk_size() {
+    return std::max<VkDeviceSize>(ring.size / 2, STAGING_ALIGNMENT);
+}
+
+void spock::begin_upload_batch() {
+    assert(!batch.open);
+    reclaim_staging(upload_timeline().completed_value());
+    begin_batch_command();
+    batch.open = true;
+}
+
+bool spock::upload_batch_open() {
+    return batch.open;
+}
+
+Ticket spock::end_upload_batch() {
+    assert(batch.open);
+    uint64_t value = submit_batch_command();
+    batch.open     = false;
+    return {&ctx.timeline, value};
+}
+
+void spock::upload_buffer(VkBuffer dst, const void* src, VkDeviceSize dstOffset, VkDeviceSize size) {
+    assert(batch.open);
+    batch.bufferUploads = true;
+    //on the graphics queue, earlier reads of the range have to finish before it is overwritten.
+    //a dedicated transfer queue waits on the graphics timeline instead (submit_batch_command)
+    if (!ctx.dedicatedTransfer)
+        buffer_barrier(batch.cmd, dst, dstOffset, size, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+                       VK_ACCESS_2_TRANSFER_WRITE_BIT);
+    VkDeviceSize chunk = max_chunk_size();
+    for (VkDeviceSize done = 0; done < size; done += chunk) {
+        VkDeviceSize n = std::min(chunk, size - done);
+
+        VkBufferCopy bufferCopy;
+        bufferCopy.srcOffset = write_staging((const char*)src + done, n);
+        bufferCopy.dstOffset = dstOffset + done;
+        bufferCopy.size      = n;
+        vkCmdCopyBuffer(batch.cmd, ring.buffer.buffer, dst, 1, &bufferCopy);
+    }
+
+    //buffers are concurrent with a dedicated transfer queue (create_buffer), no ownership transfer.
+    //the graphics side waits on the transfer timeline, which makes the writes visible
+    if (ctx.dedicatedTransfer)
+        return;
+    VkBufferMemoryBarrier2 barrier = {.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2};
+    barrier.srcStageMask           = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    barrier.srcAccessMask          = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask           = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    barrier.dstAccessMask          = VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT;
+    barrier.srcQueueFamilyIndex    = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex    = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer                 = dst;
+    barrier.offset                 = dstOffset;
+    barrier.size                   = size;
+    batch.bufferBarriers.push_back(barrier);
+}
+
+void spock::upload_image(const Image& image, const void* src, VkDeviceSize size) {
+    assert(batch.open);
+    image_barrier(batch.cmd, image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    VkBufferImageCopy copyRegion = {};
+    copyRegion.bufferRowLength   = 0;
+    copyRegion.bufferImageHeight = 0;
+
+    copyRegion.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.imageSubresource.mipLevel       = 0;
+    copyRegion.imageSubresource.baseArrayLayer = 0;
+    copyRegion.imageSubresource.layerCount     = 1;
+
+    VkExtent3D extent = image.imageExtent;
+    if (size <= max_chunk_size()) {
+        copyRegion.bufferOffset = write_staging(src, size);
+        copyRegion.imageExtent  = extent;
+        vkCmdCopyBufferToImage(batch.cmd, ring.buffer.buffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+    } else {
+        //too big for the ring, copy in bands of whole rows, one depth slice at a time
+        VkDeviceSize rowSize     = size / (VkDeviceSize(extent.height) * extent.depth);
+        uint32_t     rowsPerCopy = uint32_t(std::max<VkDeviceSize>(max_chunk_size() / rowSize, 1));
+        const char*  pixels      = (const char*)src;
+        //a single row is bigger than a chunk, copy it in runs of texels instead
+        VkDeviceSize texelSize     = rowSize / extent.width;
+        uint32_t     texelsPerCopy = uint32_t(std::max<VkDeviceSize>(max_chunk_size() / texelSize, 1));
+        for (uint32_t z = 0; z < extent.depth && rowSize > max_chunk_size(); z++) {
+            for (uint32_t y = 0; y < extent.height; y++) {
+                for (uint32_t x = 0; x < extent.width; x += texelsPerCopy) {
+                    uint32_t texels         = std::min(texelsPerCopy, extent.width - x);
+                    copyRegion.bufferOffset = write_staging(pixels, texels * texelSize);
+                    copyRegion.imageOffset  = {int32_t(x), int32_t(y), int32_t(z)};
+                    copyRegion.imageExtent  = {texels, 1, 1};
+                    vkCmdCopyBufferToImage(batch.cmd, ring.buffer.buffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+                    pixels += texels * texelSize;
+                }
+            }
+        }
+        for (uint32_t z = 0; z < extent.depth && rowSize <= max_chunk_size(); z++) {
+            for (uint32_t y = 0; y < extent.height; y += rowsPerCopy) {
+                uint32_t rows           = std::min(rowsPerCopy, extent.height - y);
+                copyRegion.bufferOffset = write_staging(pixels, rows * rowSize);
+                copyRegion.imageOffset  = {0, int32_t(y), int32_t(z)};
+                copyRegion.imageExtent  = {extent.width, rows, 1};
+                vkCmdCopyBufferToImage(batch.cmd, ring.buffer.buffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+                pixels += rows * rowSize;
+            }
+        }
+    }
+
+    VkImageMemoryBarrier2 barrier = {.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+    barrier.srcStageMask          = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    barrier.srcAccessMask         = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask          = ctx.dedicatedTransfer ? VK_PIPELINE_STAGE_2_NONE : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    barrier.dstAccessMask         = ctx.dedicatedTransfer ? VK_ACCESS_2_NONE : VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT;
+    barrier.oldLayout             = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout             = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcQueueFamilyIndex   = ctx.dedicatedTransfer ? ctx.transferQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex   = ctx.dedicatedTransfer ? ctx.graphicsQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+    barrier.image                 = image.image;
+    barrier.subresourceRange      = image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+    batch.imageBarriers.push_back(barrier);
+}